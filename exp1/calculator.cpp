@@ -7,6 +7,48 @@
 #include <functional>
 #include <map>
 #include <iomanip>
+#include <string_view>
+#include <charconv>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <queue>
+#include <chrono>
+#include <cstdio>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#if defined(CALC_PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
 
 #define N_OPTR 9 //运算符总数
 typedef enum {ADD, SUB, MUL, DIV, POW, FAC, L_P, R_P, EOE} Operator; //运算符集合
@@ -94,36 +136,501 @@ public:
     }
 };
 
-// 阶乘函数
-double factorial(double n) {
-    if (n < 0 || n != (int)n) {
-        throw std::runtime_error("Factorial only defined for non-negative integers");
+// 小缓冲栈模板类：深度不超过 N 时元素存放在对象内部，超过时才转移到堆上
+template<typename T, int N = 32>
+class SmallStack {
+private:
+    T inlineData[N];
+    std::vector<T> heapData; // 溢出后的存储，clear 后保留容量以便复用
+    T* data = inlineData;
+    int count = 0;
+    int capacity = N;
+    
+    size_t growths = 0; // 扩容次数，每次扩容分配一次堆内存
+    
+    void grow() {
+        std::vector<T> bigger(capacity * 2);
+        std::copy(data, data + count, bigger.begin());
+        heapData.swap(bigger);
+        data = heapData.data();
+        capacity *= 2;
+        growths++;
     }
-    if (n == 0 || n == 1) {
-        return 1;
+    
+public:
+    SmallStack() {}
+    SmallStack(const SmallStack&) = delete;
+    SmallStack& operator=(const SmallStack&) = delete;
+    
+    // 获取栈大小
+    int size() const {
+        return count;
     }
-    double result = 1;
-    for (int i = 2; i <= (int)n; i++) {
-        result *= i;
+    
+    // 判断栈是否为空
+    bool empty() const {
+        return count == 0;
+    }
+    
+    // 获取栈顶元素
+    T& top() {
+        if (empty()) {
+            throw std::runtime_error("Stack is empty");
+        }
+        return data[count - 1];
+    }
+    
+    // 入栈
+    void push(const T& element) {
+        if (count == capacity) {
+            grow();
+        }
+        data[count++] = element;
+    }
+    
+    // 出栈
+    void pop() {
+        if (empty()) {
+            throw std::runtime_error("Stack is empty");
+        }
+        count--;
+    }
+    
+    // 不检查的栈顶访问与出栈：仅用于编译期已验证操作数个数的场合
+    T& topUnchecked() {
+        return data[count - 1];
+    }
+    
+    void popUnchecked() {
+        count--;
+    }
+    
+    // 清空栈
+    void clear() {
+        count = 0;
+    }
+    
+    // 调整元素个数，以便当作定长数组按下标访问（新增元素的值未指定）
+    void resize(int n) {
+        while (capacity < n) {
+            grow();
+        }
+        count = n;
+    }
+    
+    T& operator[](int index) {
+        return data[index];
+    }
+    
+    // 累计的堆分配次数（只在溢出内联存储后扩容时分配）
+    size_t allocations() const {
+        return growths;
+    }
+};
+
+// 求值上下文：持有求值所用的栈，可在多次求值间复用（每个线程使用各自的上下文）
+struct EvalContext {
+    SmallStack<double> operands;    // 操作数栈
+    SmallStack<Operator> operators; // 运算符栈
+    SmallStack<double> temps;       // 公共子表达式的临时值
+    
+    // 各栈累计的堆分配次数，用于检查复用上下文的求值不分配内存
+    size_t allocations() const {
+        return operands.allocations() + operators.allocations() + temps.allocations();
+    }
+};
+
+// 求值状态码（编译执行的热路径不抛异常，用状态码报告错误）
+typedef enum {EVAL_OK, EVAL_DIV_ZERO, EVAL_FAC_DOMAIN, EVAL_LOG_DOMAIN, EVAL_LN_DOMAIN,
+              EVAL_SQRT_DOMAIN, EVAL_BAD_OP, EVAL_UNBOUND} EvalStatus;
+
+// 状态码对应的错误信息（与抛出的异常信息一致）
+const char* const evalMessage[] = {
+    "OK",
+    "Division by zero",
+    "Factorial undefined for negative integers",
+    "Log of non-positive number",
+    "Ln of non-positive number",
+    "Square root of negative number",
+    "Invalid binary operation",
+    "Unbound variable"
+};
+
+// ===================== 性能剖析（编译时加 -DCALC_PROFILE 启用） =====================
+
+// 延迟直方图：对数-线性分桶（每个 2 的幂区间再分 8 个子桶），相对误差不超过 1/8。
+// 桶为定长数组，对象可以常量初始化（用作 thread_local 时没有初始化检查）
+class LatencyHistogram {
+private:
+    static const int SUB_BITS = 3;
+    static const int N_BUCKET = 64 << SUB_BITS;
+    uint64_t buckets[N_BUCKET] = {};
+    uint64_t total = 0;
+    uint64_t maximum = 0;
+    
+    static int bucketOf(uint64_t value) {
+        if (value < (1u << SUB_BITS)) {
+            return (int)value;
+        }
+        int high = 63 - __builtin_clzll(value);
+        return ((high - SUB_BITS + 1) << SUB_BITS) + (int)((value >> (high - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+    }
+    
+    // 桶的代表值（区间中点）
+    static uint64_t valueOf(int bucket) {
+        if (bucket < (1 << SUB_BITS)) {
+            return bucket;
+        }
+        int shift = (bucket >> SUB_BITS) - 1;
+        uint64_t low = (uint64_t)((1 << SUB_BITS) + (bucket & ((1 << SUB_BITS) - 1))) << shift;
+        return low + ((1ull << shift) >> 1);
+    }
+    
+public:
+    void record(uint64_t value, uint64_t count = 1) {
+        buckets[bucketOf(value)] += count;
+        total += count;
+        maximum = std::max(maximum, value);
+    }
+    
+    void merge(const LatencyHistogram& other) {
+        for (int b = 0; b < N_BUCKET; b++) {
+            buckets[b] += other.buckets[b];
+        }
+        total += other.total;
+        maximum = std::max(maximum, other.maximum);
+    }
+    
+    uint64_t count() const {
+        return total;
+    }
+    
+    uint64_t max() const {
+        return maximum;
+    }
+    
+    // 第 p 分位（0 < p <= 1）的近似值
+    uint64_t percentile(double p) const {
+        uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(p * total));
+        uint64_t seen = 0;
+        for (int b = 0; b < N_BUCKET; b++) {
+            seen += buckets[b];
+            if (seen >= target) {
+                return std::min(valueOf(b), maximum);
+            }
+        }
+        return maximum;
+    }
+};
+
+#ifdef CALC_PROFILE
+
+#ifndef CALC_PROFILE_SAMPLE
+#define CALC_PROFILE_SAMPLE 16 //计时采样周期（2 的幂），每个阶段每 N 次调用读一次时钟；1 表示每次都计时
+#endif
+
+// 计时阶段（包含时间，嵌套的阶段会重复计入外层）
+typedef enum {PHASE_BASIC, PHASE_COMPILE, PHASE_OPTIMIZE, PHASE_EVALUATE, PHASE_CACHE, N_PHASE} ProfilePhase;
+const char* const phaseName[N_PHASE] = {"basic_evaluate", "compile", "optimize", "evaluate", "cache_lookup"};
+
+// 计数器
+typedef enum {COUNTER_EXPRESSIONS, COUNTER_TOKENS, COUNTER_REDUCTIONS, COUNTER_FUNCTION_CALLS,
+              COUNTER_EXCEPTIONS, N_COUNTER} ProfileCounter;
+const char* const counterName[N_COUNTER] = {"expressions", "tokens", "reductions", "function_calls",
+                                            "exceptions"};
+
+// 高水位标记
+typedef enum {MARK_OPERAND_STACK, MARK_OPERATOR_STACK, N_MARK} ProfileMark;
+const char* const markName[N_MARK] = {"operand_stack", "operator_stack"};
+
+// 时钟：x86 上读时间戳计数器，其他平台用纳秒
+inline uint64_t profileTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// 一个线程的剖析数据
+struct ProfileData {
+    uint64_t ticks[N_PHASE] = {}; // 采样到的时钟周期
+    uint64_t calls[N_PHASE] = {};
+    uint64_t counters[N_COUNTER] = {};
+    uint64_t marks[N_MARK] = {};
+    LatencyHistogram latency; // 采样到的单个表达式耗时（时钟周期）
+    
+    void merge(const ProfileData& other) {
+        for (int p = 0; p < N_PHASE; p++) {
+            ticks[p] += other.ticks[p];
+            calls[p] += other.calls[p];
+        }
+        for (int c = 0; c < N_COUNTER; c++) {
+            counters[c] += other.counters[c];
+        }
+        for (int m = 0; m < N_MARK; m++) {
+            marks[m] = std::max(marks[m], other.marks[m]);
+        }
+        latency.merge(other.latency);
+    }
+};
+
+// 本线程的剖析数据：热路径只写本线程的数据，不加锁
+thread_local ProfileData profileData;
+
+// 汇总各线程的剖析数据。导出时合并存活线程与已退出线程的数据；
+// 在工作线程运行期间导出得到的是近似值
+class Profiler {
+private:
+    std::mutex mutex;
+    std::vector<const ProfileData*> threads; // 存活线程的数据
+    ProfileData retired;                     // 已退出线程的数据
+    uint64_t startTicks = profileTicks();
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    
+    Profiler() {}
+    
+public:
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+    
+    // 退出时若设置了环境变量 CALC_PROFILE_JSON，把结果写到该文件（"-" 表示标准错误）
+    ~Profiler() {
+        const char* path = getenv("CALC_PROFILE_JSON");
+        if (!path) {
+            return;
+        }
+        std::string text = json();
+        FILE* file = std::string(path) == "-" ? stderr : fopen(path, "w");
+        if (file) {
+            fwrite(text.data(), 1, text.size(), file);
+            if (file != stderr) {
+                fclose(file);
+            }
+        }
+    }
+    
+    void attach(const ProfileData* data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.push_back(data);
+    }
+    
+    void detach(const ProfileData* data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired.merge(*data);
+        threads.erase(std::find(threads.begin(), threads.end(), data));
+    }
+    
+    ProfileData snapshot() {
+        std::lock_guard<std::mutex> lock(mutex);
+        ProfileData total = retired;
+        for (const ProfileData* data : threads) {
+            total.merge(*data);
+        }
+        return total;
+    }
+    
+    // 以 JSON 输出全部剖析数据；时钟周期按运行期间测得的频率换算为纳秒
+    std::string json() {
+        ProfileData data = snapshot();
+        double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+        double nsPerTick = elapsedNs > 0 ? elapsedNs / std::max<uint64_t>(1, profileTicks() - startTicks) : 1;
+        
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(3);
+        out << "{\n  \"sample_period\": " << CALC_PROFILE_SAMPLE << ",\n";
+        out << "  \"ghz\": " << 1 / nsPerTick << ",\n";
+        out << "  \"phases\": {";
+        for (int p = 0; p < N_PHASE; p++) {
+            double ns = data.ticks[p] * (double)CALC_PROFILE_SAMPLE * nsPerTick;
+            out << (p ? ",\n" : "\n") << "    \"" << phaseName[p] << "\": {\"calls\": " << data.calls[p]
+                << ", \"total_ns\": " << ns << ", \"mean_ns\": " << ns / std::max<uint64_t>(1, data.calls[p]) << "}";
+        }
+        out << "\n  },\n  \"counters\": {";
+        for (int c = 0; c < N_COUNTER; c++) {
+            out << (c ? ", " : "") << "\"" << counterName[c] << "\": " << data.counters[c];
+        }
+        out << "},\n  \"high_water\": {";
+        for (int m = 0; m < N_MARK; m++) {
+            out << (m ? ", " : "") << "\"" << markName[m] << "\": " << data.marks[m];
+        }
+        out << "},\n  \"expression_latency_ns\": {\"samples\": " << data.latency.count();
+        const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+        const char* const quantileName[] = {"p50", "p90", "p99", "p999"};
+        for (int q = 0; q < 4; q++) {
+            out << ", \"" << quantileName[q] << "\": " << data.latency.percentile(quantiles[q]) * nsPerTick;
+        }
+        out << ", \"max\": " << data.latency.max() * nsPerTick << "}\n}\n";
+        return out.str();
+    }
+};
+
+// 线程首次进入计时区域时登记剖析数据，线程退出时并入汇总
+struct ProfileThread {
+    ProfileThread() {
+        Profiler::instance().attach(&profileData);
+    }
+    
+    ~ProfileThread() {
+        Profiler::instance().detach(&profileData);
+    }
+    
+    void touch() {}
+};
+
+thread_local ProfileThread profileThread;
+
+// 阶段计时器：按采样周期读时钟
+class PhaseTimer {
+private:
+    ProfilePhase phase;
+    uint64_t start = 0;
+    
+public:
+    explicit PhaseTimer(ProfilePhase p) : phase(p) {
+        profileThread.touch();
+        if ((profileData.calls[phase]++ & (CALC_PROFILE_SAMPLE - 1)) == 0) {
+            start = profileTicks();
+        }
+    }
+    
+    ~PhaseTimer() {
+        if (start) {
+            profileData.ticks[phase] += profileTicks() - start;
+        }
+    }
+};
+
+// 单个表达式计时器：记录耗时直方图，并统计以异常结束的表达式
+class ExpressionTimer {
+private:
+    uint64_t start = 0;
+    int exceptions = std::uncaught_exceptions();
+    
+public:
+    ExpressionTimer() {
+        profileThread.touch();
+        if ((profileData.counters[COUNTER_EXPRESSIONS]++ & (CALC_PROFILE_SAMPLE - 1)) == 0) {
+            start = profileTicks();
+        }
+    }
+    
+    ~ExpressionTimer() {
+        if (start) {
+            profileData.latency.record(profileTicks() - start);
+        }
+        if (std::uncaught_exceptions() > exceptions) {
+            profileData.counters[COUNTER_EXCEPTIONS]++;
+        }
+    }
+};
+
+// 局部计数器：循环内只累加局部变量，离开作用域时一次并入本线程数据
+class LocalCounter {
+private:
+    ProfileCounter counter;
+    
+public:
+    uint64_t n = 0;
+    
+    explicit LocalCounter(ProfileCounter c) : counter(c) {}
+    
+    ~LocalCounter() {
+        profileData.counters[counter] += n;
+    }
+};
+
+#define PROFILE_PHASE(phase) PhaseTimer profilePhaseTimer(phase)
+#define PROFILE_EXPRESSION() ExpressionTimer profileExpressionTimer
+#define PROFILE_COUNT(counter, n) (profileData.counters[counter] += (n))
+#define PROFILE_LOCAL_COUNTER(name, counter) LocalCounter name(counter)
+#define PROFILE_LOCAL_COUNT(name) (name.n++)
+#define PROFILE_HIGH_WATER(mark, value) \
+    (profileData.marks[mark] = std::max<uint64_t>(profileData.marks[mark], (value)))
+
+#else
+
+// 未启用时所有剖析宏展开为空，没有任何开销
+#define PROFILE_PHASE(phase) ((void)0)
+#define PROFILE_EXPRESSION() ((void)0)
+#define PROFILE_COUNT(counter, n) ((void)0)
+#define PROFILE_LOCAL_COUNTER(name, counter) ((void)0)
+#define PROFILE_LOCAL_COUNT(name) ((void)0)
+#define PROFILE_HIGH_WATER(mark, value) ((void)0)
+
+#endif
+
+#define N_FACTORIAL 171 //阶乘表长度，171! 起超出 double 范围
+
+// 阶乘表：0!~170!，编译期按与逐项连乘相同的顺序生成
+struct FactorialTable {
+    double value[N_FACTORIAL];
+    
+    constexpr FactorialTable() : value() {
+        value[0] = 1;
+        for (int i = 1; i < N_FACTORIAL; i++) {
+            value[i] = value[i - 1] * i;
+        }
+    }
+};
+
+constexpr FactorialTable factorialTable;
+
+// 阶乘函数（状态码版本）：整数查表，非整数按 Γ(n+1) 扩展，负整数无定义
+EvalStatus factorialStatus(double n, double& result) {
+    if (n == std::floor(n)) {
+        if (n < 0) {
+            return EVAL_FAC_DOMAIN;
+        }
+        result = n < N_FACTORIAL ? factorialTable.value[(int)n] : INFINITY;
+        return EVAL_OK;
+    }
+    if (std::isnan(n)) {
+        return EVAL_FAC_DOMAIN;
+    }
+    result = std::tgamma(n + 1);
+    return EVAL_OK;
+}
+
+// 阶乘函数
+double factorial(double n) {
+    double result;
+    EvalStatus status = factorialStatus(n, result);
+    if (status != EVAL_OK) {
+        throw std::runtime_error(evalMessage[status]);
     }
     return result;
 }
 
-// 执行二元运算
-double calculate(double a, Operator op, double b) {
+// 执行二元运算（状态码版本）
+EvalStatus calculateStatus(double a, Operator op, double b, double& result) {
     switch (op) {
-        case ADD: return a + b;
-        case SUB: return a - b;
-        case MUL: return a * b;
-        case DIV: 
+        case ADD: result = a + b; return EVAL_OK;
+        case SUB: result = a - b; return EVAL_OK;
+        case MUL: result = a * b; return EVAL_OK;
+        case DIV:
             if (b == 0) {
-                throw std::runtime_error("Division by zero");
+                return EVAL_DIV_ZERO;
             }
-            return a / b;
-        case POW: return pow(a, b);
+            result = a / b;
+            return EVAL_OK;
+        case POW: result = b == 2 ? a * a : pow(a, b); return EVAL_OK; // 平方直接相乘，结果正确舍入
         default:
-            throw std::runtime_error("Invalid binary operation");
+            return EVAL_BAD_OP;
+    }
+}
+
+// 执行二元运算
+double calculate(double a, Operator op, double b) {
+    double result;
+    EvalStatus status = calculateStatus(a, op, b, result);
+    if (status != EVAL_OK) {
+        throw std::runtime_error(evalMessage[status]);
     }
+    return result;
 }
 
 // 执行一元运算（阶乘）
@@ -131,269 +638,2713 @@ double calculate(Operator op, double a) {
     if (op == FAC) {
         return factorial(a);
     }
-    throw std::runtime_error("Invalid unary operation");
-}
-
-// 判断是否为数字字符
-bool isDigit(char c) {
-    return std::isdigit(c) || c == '.';
-}
-
-// 获取运算符优先级
-char getPriority(Operator op1, Operator op2) {
-    return pri[op1][op2];
-}
-
-// 从字符串中提取下一个数字
-std::pair<double, int> getNextNumber(const std::string& expr, int start) {
-    std::string numStr = "";
-    int i = start;
+    throw std::runtime_error("Invalid unary operation");
+}
+
+// 判断是否为数字字符
+bool isDigit(char c) {
+    return std::isdigit((unsigned char)c) || c == '.';
+}
+
+// 获取运算符优先级
+char getPriority(Operator op1, Operator op2) {
+    return pri[op1][op2];
+}
+
+// 带出错位置的解析异常
+class ParseError : public std::runtime_error {
+private:
+    size_t pos;
+    
+public:
+    ParseError(const std::string& message, size_t position)
+        : std::runtime_error(message + " at position " + std::to_string(position)), pos(position) {}
+    
+    // 出错字符在表达式中的下标（从 0 开始）
+    size_t position() const {
+        return pos;
+    }
+};
+
+// 词法单元类型：数字、运算符、标识符、一元负号、结束
+typedef enum {T_NUMBER, T_OPERATOR, T_IDENT, T_NEGATE, T_END} TokenType;
+
+// 词法单元
+struct Token {
+    TokenType type;
+    Operator op;           // T_OPERATOR 的运算符
+    double value;          // T_NUMBER 的数值
+    std::string_view text; // 在表达式中对应的原文
+    size_t offset;         // 在表达式中的起始位置
+};
+
+// 词法分析器：直接在 string_view 上扫描，不复制输入、不分配内存
+class Tokenizer {
+private:
+    std::string_view expr;
+    size_t pos = 0;
+    bool expectOperand = true; // 下一个单元应为操作数（此时 '-' 为负号）
+    
+    static bool isIdentStart(char c) {
+        return std::isalpha((unsigned char)c) || c == '_';
+    }
+    
+    static bool isIdentChar(char c) {
+        return std::isalnum((unsigned char)c) || c == '_';
+    }
+    
+    Token make(TokenType type, size_t start, Operator op = EOE, double value = 0) {
+        return {type, op, value, expr.substr(start, pos - start), start};
+    }
+    
+    // 读取数字（可带负号），数字字符之后必须恰好被 from_chars 完整解析
+    Token readNumber(size_t start) {
+        size_t end = pos;
+        while (end < expr.length() && isDigit(expr[end])) {
+            end++;
+        }
+        
+        double value;
+        const char* first = expr.data() + start;
+        auto parsed = std::from_chars(first, expr.data() + end, value);
+        if (parsed.ec != std::errc() || parsed.ptr == first + (pos - start)) {
+            throw ParseError("Invalid number format", start);
+        }
+        if (parsed.ptr != expr.data() + end) {
+            // 如 1.2.3：报告第一个无法解析的字符位置
+            throw ParseError("Invalid number format", parsed.ptr - expr.data());
+        }
+        
+        pos = end;
+        expectOperand = false;
+        return make(T_NUMBER, start, EOE, value);
+    }
+    
+public:
+    explicit Tokenizer(std::string_view expression) : expr(expression) {}
+    
+    // 读取下一个词法单元，跳过空白
+    Token next() {
+        PROFILE_COUNT(COUNTER_TOKENS, 1);
+        while (pos < expr.length() && std::isspace((unsigned char)expr[pos])) {
+            pos++;
+        }
+        if (pos >= expr.length()) {
+            return {T_END, EOE, 0, std::string_view(), pos};
+        }
+        
+        size_t start = pos;
+        char c = expr[pos];
+        
+        if (c == '-' && expectOperand) {
+            pos++;
+            if (pos < expr.length() && isDigit(expr[pos])) {
+                return readNumber(start);
+            }
+            return make(T_NEGATE, start);
+        }
+        if (isDigit(c)) {
+            return readNumber(start);
+        }
+        if (isIdentStart(c)) {
+            while (pos < expr.length() && isIdentChar(expr[pos])) {
+                pos++;
+            }
+            expectOperand = false;
+            return make(T_IDENT, start);
+        }
+        
+        Operator op = char2optr(c);
+        if (op == EOE) {
+            throw ParseError(std::string("Invalid character '") + c + "'", start);
+        }
+        pos++;
+        expectOperand = op != R_P && op != FAC;
+        return make(T_OPERATOR, start, op);
+    }
+};
+
+// 对操作数栈执行一次归约
+void reduce(Operator op, SmallStack<double>& operandStack) {
+    PROFILE_COUNT(COUNTER_REDUCTIONS, 1);
+    if (op == FAC) {
+        // 阶乘是一元运算
+        if (operandStack.empty()) {
+            throw std::runtime_error("Invalid factorial operation");
+        }
+        double operand = operandStack.top();
+        operandStack.pop();
+        double result = calculate(op, operand);
+        operandStack.push(result);
+    } else {
+        // 二元运算
+        if (operandStack.size() < 2) {
+            throw std::runtime_error("Invalid expression: not enough operands");
+        }
+        double b = operandStack.top();
+        operandStack.pop();
+        double a = operandStack.top();
+        operandStack.pop();
+        double result = calculate(a, op, b);
+        operandStack.push(result);
+    }
+}
+
+// 字符串计算器主函数（基础运算），使用调用方提供的求值上下文
+double evaluateBasicExpression(std::string_view expression, EvalContext& context) {
+    if (expression.empty()) {
+        return 0;
+    }
+    PROFILE_EXPRESSION();
+    PROFILE_PHASE(PHASE_BASIC);
+    
+    Tokenizer tokenizer(expression);
+    SmallStack<double>& operandStack = context.operands; // 操作数栈
+    SmallStack<Operator>& operatorStack = context.operators; // 运算符栈
+    operandStack.clear();
+    operatorStack.clear();
+    operatorStack.push(EOE); // 先压入起始符
+    
+    Token token = tokenizer.next();
+    while (token.type != T_END) {
+        if (token.type == T_NUMBER) {
+            // 是数字（包括负数）
+            operandStack.push(token.value);
+            PROFILE_HIGH_WATER(MARK_OPERAND_STACK, operandStack.size());
+            token = tokenizer.next();
+        } else if (token.type == T_OPERATOR) {
+            switch (getPriority(operatorStack.top(), token.op)) {
+                case '<': // 栈顶运算符优先级低，入栈
+                    operatorStack.push(token.op);
+                    PROFILE_HIGH_WATER(MARK_OPERATOR_STACK, operatorStack.size());
+                    token = tokenizer.next();
+                    break;
+                    
+                case '=': // 优先级相等，脱括号
+                    operatorStack.pop(); // 弹出左括号或匹配的运算符
+                    token = tokenizer.next();
+                    break;
+                    
+                case '>': // 栈顶运算符优先级高，计算
+                {
+                    Operator op = operatorStack.top();
+                    operatorStack.pop();
+                    reduce(op, operandStack);
+                    break;
+                }
+                
+                default:
+                    throw std::runtime_error("Invalid priority relation");
+            }
+        } else if (token.type == T_NEGATE) {
+            // 基础运算只支持紧跟数字的负号
+            throw ParseError("Invalid number format", token.offset);
+        } else {
+            throw ParseError("Unexpected identifier '" + std::string(token.text) + "'", token.offset);
+        }
+    }
+    
+    // 处理栈中剩余的运算
+    while (operatorStack.top() != EOE) {
+        Operator op = operatorStack.top();
+        operatorStack.pop();
+        reduce(op, operandStack);
+    }
+    
+    if (operandStack.size() != 1) {
+        throw std::runtime_error("Invalid expression");
+    }
+    
+    return operandStack.top();
+}
+
+// 字符串计算器主函数（基础运算）
+double evaluateBasicExpression(std::string_view expression) {
+    EvalContext context;
+    return evaluateBasicExpression(expression, context);
+}
+
+#define N_FUNC 7 //内置函数总数
+typedef enum {F_SIN, F_COS, F_TAN, F_LOG, F_LN, F_SQRT, F_ABS} Function; //内置函数集合
+
+//内置函数名
+const char* const funcName[N_FUNC] = {"sin", "cos", "tan", "log", "ln", "sqrt", "abs"};
+
+// 函数实现：成功时写入 result 并返回 EVAL_OK，参数越界时返回对应状态码
+typedef EvalStatus (*FunctionImpl)(double arg, double& result);
+
+// 整数度数 [0, 360) 的三角函数表：特殊角取精确值，其余为 sin(d * M_PI / 180) 等的结果
+struct DegreeTable {
+    double sinValue[360];
+    double cosValue[360];
+    double tanValue[360];
+    
+    DegreeTable() {
+        for (int d = 0; d < 360; d++) {
+            sinValue[d] = sin(d * M_PI / 180);
+            cosValue[d] = cos(d * M_PI / 180);
+            tanValue[d] = tan(d * M_PI / 180);
+        }
+        // 特殊角：sin、cos 取 0、±1/2、±1
+        const int sinHalf[] = {30, 150, 210, 330};
+        const double sinHalfValue[] = {0.5, 0.5, -0.5, -0.5};
+        const int cosHalf[] = {60, 120, 240, 300};
+        const double cosHalfValue[] = {0.5, -0.5, -0.5, 0.5};
+        for (int k = 0; k < 4; k++) {
+            sinValue[sinHalf[k]] = sinHalfValue[k];
+            cosValue[cosHalf[k]] = cosHalfValue[k];
+        }
+        for (int d = 0; d < 360; d += 90) {
+            sinValue[d] = (d == 90) - (d == 270);
+            cosValue[d] = (d == 0) - (d == 180);
+        }
+        // tan 的特殊角：0, ±1（90°、270° 保留 libm 的结果）
+        tanValue[0] = tanValue[180] = 0;
+        tanValue[45] = tanValue[225] = 1;
+        tanValue[135] = tanValue[315] = -1;
+    }
+};
+
+const DegreeTable degreeTable;
+
+// 整数度数走查表快速路径；sin、tan 为奇函数，负角取相反数。
+// 查表前先按 360 取模，因此 |d| >= 360 时结果与直接 sin(d * M_PI / 180) 不同：
+// 取模消除了大角度乘 M_PI 的舍入误差，例如 sin(390) 精确为 0.5，而非 libm 的近似值
+inline bool degreeLookup(const double (&table)[360], double arg, bool odd, double& result) {
+    double magnitude = std::fabs(arg);
+    if (!(magnitude < 2147483648.0)) { // 2^31，同时排除 NaN
+        return false;
+    }
+    int degrees = (int)magnitude;
+    if (degrees != magnitude) {
+        return false;
+    }
+    result = table[degrees % 360];
+    if (odd && arg < 0) {
+        result = -result;
+    }
+    return true;
+}
+
+// 执行内置函数运算（状态码版本）
+EvalStatus builtinFunction(Function func, double arg, double& result) {
+    switch (func) {
+        case F_SIN: // 假设输入为度数
+            if (!degreeLookup(degreeTable.sinValue, arg, true, result)) result = sin(arg * M_PI / 180);
+            return EVAL_OK;
+        case F_COS: // 假设输入为度数
+            if (!degreeLookup(degreeTable.cosValue, arg, false, result)) result = cos(arg * M_PI / 180);
+            return EVAL_OK;
+        case F_TAN: // 假设输入为度数
+            if (!degreeLookup(degreeTable.tanValue, arg, true, result)) result = tan(arg * M_PI / 180);
+            return EVAL_OK;
+        case F_LOG:
+            if (arg <= 0) return EVAL_LOG_DOMAIN;
+            result = log10(arg);
+            return EVAL_OK;
+        case F_LN:
+            if (arg <= 0) return EVAL_LN_DOMAIN;
+            result = log(arg);
+            return EVAL_OK;
+        case F_SQRT:
+            if (arg < 0) return EVAL_SQRT_DOMAIN;
+            result = sqrt(arg);
+            return EVAL_OK;
+        case F_ABS: result = std::fabs(arg); return EVAL_OK;
+    }
+    return EVAL_BAD_OP;
+}
+
+// 函数注册表：函数名 -> 函数编号。编号 0~N_FUNC-1 为内置函数，之后为扩展函数
+class FunctionRegistry {
+private:
+    std::map<std::string, int> ids;
+    std::vector<FunctionImpl> extensions; // 扩展函数实现，下标为 编号 - N_FUNC
+    
+    FunctionRegistry() {
+        for (int i = 0; i < N_FUNC; i++) {
+            ids[funcName[i]] = i;
+        }
+    }
+    
+public:
+    static FunctionRegistry& instance() {
+        static FunctionRegistry registry;
+        return registry;
+    }
+    
+    // 注册扩展函数，返回函数编号。同名时覆盖，已编译的程序不受影响。
+    // 注册应在并发编译、求值开始之前完成
+    int add(const std::string& name, FunctionImpl impl) {
+        extensions.push_back(impl);
+        int func = N_FUNC + (int)extensions.size() - 1;
+        ids[name] = func;
+        return func;
+    }
+    
+    // 查找函数编号，未注册则返回 -1
+    int find(const std::string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? -1 : it->second;
+    }
+    
+    FunctionImpl extension(int func) const {
+        return extensions[func - N_FUNC];
+    }
+};
+
+// 执行函数运算（状态码版本）
+inline EvalStatus evaluateFunctionStatus(int func, double arg, double& result) {
+    if (func < N_FUNC) {
+        return builtinFunction((Function)func, arg, result);
+    }
+    return FunctionRegistry::instance().extension(func)(arg, result);
+}
+
+// 按函数名执行函数运算
+class FunctionParser {
+public:
+    static double evaluateFunction(const std::string& func_name, double arg) {
+        PROFILE_COUNT(COUNTER_FUNCTION_CALLS, 1);
+        int func = FunctionRegistry::instance().find(func_name);
+        if (func < 0) {
+            throw std::runtime_error("Unknown function: " + func_name);
+        }
+        double result;
+        EvalStatus status = evaluateFunctionStatus(func, arg, result);
+        if (status != EVAL_OK) {
+            throw std::runtime_error(evalMessage[status]);
+        }
+        return result;
+    }
+};
+
+// ===================== 表达式编译：一次解析，多次求值 =====================
+
+// 字节码操作码：I_ADD~I_FAC 与 Operator 枚举取值一致，其余为取数、取负、函数和临时值存取指令
+typedef enum {I_ADD = ADD, I_SUB = SUB, I_MUL = MUL, I_DIV = DIV, I_POW = POW, I_FAC = FAC,
+              I_NUM, I_VAR, I_NEG, I_FUNC, I_STORE, I_LOAD} OpCode;
+
+// 字节码指令
+struct Instruction {
+    OpCode code;
+    double value; // I_NUM 的常数
+    int arg;      // I_VAR 的变量槽位，I_FUNC 的函数编号，I_STORE/I_LOAD 的临时槽位
+};
+
+// 编译后的表达式程序（后缀形式）
+struct Program {
+    std::vector<Instruction> code;
+    std::vector<std::string> variables; // 变量槽位 -> 变量名
+    int maxDepth = 0;                   // 求值所需的最大栈深度
+    int numTemps = 0;                   // 公共子表达式的临时槽位数
+    
+    // 查找变量槽位，不存在则返回 -1
+    int slotOf(const std::string& name) const {
+        for (size_t i = 0; i < variables.size(); i++) {
+            if (variables[i] == name) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+};
+
+// 表达式编译器：沿用 pri 表的算符优先分析，但把归约动作换成生成指令
+class ExpressionCompiler {
+private:
+    // 左括号附带的信息：括号前的函数编号（-1 表示普通括号）与是否取负
+    struct Group {
+        int func;
+        bool negate;
+    };
+    
+    Program program;
+    int depth = 0; // 当前操作数栈深度（编译期模拟）
+    
+    void emit(OpCode code, double value = 0, int arg = 0) {
+        program.code.push_back({code, value, arg});
+    }
+    
+    // 生成取数指令
+    void emitOperand(OpCode code, double value, int arg) {
+        emit(code, value, arg);
+        depth++;
+        if (depth > program.maxDepth) {
+            program.maxDepth = depth;
+        }
+    }
+    
+    // 生成运算指令，并按与 evaluateBasicExpression 相同的规则检查操作数个数
+    void emitOperator(Operator op) {
+        if (op == FAC) {
+            if (depth < 1) {
+                throw std::runtime_error("Invalid factorial operation");
+            }
+            emit(I_FAC);
+            return;
+        }
+        if (depth < 2) {
+            throw std::runtime_error("Invalid expression: not enough operands");
+        }
+        if (op > POW) {
+            throw std::runtime_error("Invalid binary operation");
+        }
+        emit((OpCode)op);
+        depth--;
+    }
+    
+    int variableSlot(std::string_view name) {
+        int slot = program.slotOf(std::string(name));
+        if (slot < 0) {
+            program.variables.emplace_back(name);
+            slot = (int)program.variables.size() - 1;
+        }
+        return slot;
+    }
+    
+public:
+    explicit ExpressionCompiler(const std::vector<std::string>& variables) {
+        program.variables = variables;
+    }
+    
+    Program compile(std::string_view expression) {
+        Tokenizer tokenizer(expression);
+        Stack<Operator> operatorStack; // 运算符栈
+        Stack<Group> groupStack;       // 与栈中左括号一一对应
+        operatorStack.push(EOE);
+        
+        Group pending = {-1, false}; // 下一个操作数（或左括号）的附带信息
+        Token token = tokenizer.next();
+        
+        while (token.type != T_END) {
+            switch (token.type) {
+                case T_NEGATE: // 变量、函数调用或括号前的一元负号
+                    pending.negate = !pending.negate;
+                    token = tokenizer.next();
+                    break;
+                    
+                case T_NUMBER:
+                    emitOperand(I_NUM, pending.negate ? -token.value : token.value, 0);
+                    pending.negate = false;
+                    token = tokenizer.next();
+                    break;
+                    
+                case T_IDENT: // 后跟左括号为函数调用，否则为变量
+                {
+                    Token following = tokenizer.next();
+                    if (following.type == T_OPERATOR && following.op == L_P) {
+                        pending.func = FunctionRegistry::instance().find(std::string(token.text));
+                        if (pending.func < 0) {
+                            throw ParseError("Unknown function: " + std::string(token.text),
+                                             token.offset);
+                        }
+                    } else {
+                        emitOperand(I_VAR, 0, variableSlot(token.text));
+                        if (pending.negate) {
+                            emit(I_NEG);
+                            pending.negate = false;
+                        }
+                    }
+                    token = following;
+                    break;
+                }
+                
+                default: // 是运算符
+                    if (pending.negate && token.op != L_P) {
+                        throw ParseError("Invalid number format", token.offset);
+                    }
+                    
+                    switch (getPriority(operatorStack.top(), token.op)) {
+                        case '<': // 栈顶运算符优先级低，入栈
+                            operatorStack.push(token.op);
+                            if (token.op == L_P) {
+                                groupStack.push(pending);
+                                pending = {-1, false};
+                            }
+                            token = tokenizer.next();
+                            break;
+                            
+                        case '=': // 脱括号，括号前若有函数名或负号则在此生成对应指令
+                        {
+                            operatorStack.pop();
+                            Group group = groupStack.top();
+                            groupStack.pop();
+                            if (group.func >= 0) {
+                                emit(I_FUNC, 0, group.func);
+                            }
+                            if (group.negate) {
+                                emit(I_NEG);
+                            }
+                            token = tokenizer.next();
+                            break;
+                        }
+                        
+                        case '>': // 栈顶运算符优先级高，生成运算指令
+                        {
+                            Operator op = operatorStack.top();
+                            operatorStack.pop();
+                            emitOperator(op);
+                            break;
+                        }
+                        
+                        default:
+                            throw std::runtime_error("Invalid priority relation");
+                    }
+                    break;
+            }
+        }
+        
+        if (pending.negate) {
+            throw ParseError("Invalid number format", expression.length());
+        }
+        
+        // 处理栈中剩余的运算
+        while (operatorStack.top() != EOE) {
+            Operator op = operatorStack.top();
+            operatorStack.pop();
+            emitOperator(op);
+        }
+        
+        if (depth != 1) {
+            throw std::runtime_error("Invalid expression");
+        }
+        
+        return program;
+    }
+};
+
+// 编译表达式；variables 预先指定变量槽位顺序，表达式中新出现的变量依次追加
+Program compileExpression(std::string_view expression,
+                          const std::vector<std::string>& variables = {}) {
+    PROFILE_PHASE(PHASE_COMPILE);
+    return ExpressionCompiler(variables).compile(expression);
+}
+
+// 执行编译后的程序：bindings 按槽位给出变量值，热路径不解析、不分配内存、不抛异常
+EvalStatus evaluate(const Program& program, const double* bindings, double& result,
+                    EvalContext& context) {
+    PROFILE_PHASE(PHASE_EVALUATE);
+    PROFILE_HIGH_WATER(MARK_OPERAND_STACK, program.maxDepth);
+    PROFILE_LOCAL_COUNTER(reductions, COUNTER_REDUCTIONS);
+    PROFILE_LOCAL_COUNTER(functionCalls, COUNTER_FUNCTION_CALLS);
+    SmallStack<double>& operandStack = context.operands;
+    SmallStack<double>& temps = context.temps;
+    operandStack.clear();
+    temps.resize(program.numTemps);
+    
+    // 操作数个数已在编译时验证，可使用不检查的栈操作
+    for (const Instruction& ins : program.code) {
+        switch (ins.code) {
+            case I_NUM:
+                operandStack.push(ins.value);
+                break;
+            case I_VAR:
+                operandStack.push(bindings[ins.arg]);
+                break;
+            case I_STORE:
+                temps[ins.arg] = operandStack.topUnchecked();
+                break;
+            case I_LOAD:
+                operandStack.push(temps[ins.arg]);
+                break;
+            case I_NEG:
+                operandStack.topUnchecked() = -operandStack.topUnchecked();
+                break;
+            case I_FAC:
+            {
+                PROFILE_LOCAL_COUNT(reductions);
+                double& top = operandStack.topUnchecked();
+                EvalStatus status = factorialStatus(top, top);
+                if (status != EVAL_OK) return status;
+                break;
+            }
+            case I_FUNC:
+            {
+                PROFILE_LOCAL_COUNT(functionCalls);
+                double& top = operandStack.topUnchecked();
+                EvalStatus status = evaluateFunctionStatus(ins.arg, top, top);
+                if (status != EVAL_OK) return status;
+                break;
+            }
+            default:
+            {
+                PROFILE_LOCAL_COUNT(reductions);
+                double b = operandStack.topUnchecked();
+                operandStack.popUnchecked();
+                double& top = operandStack.topUnchecked();
+                EvalStatus status = calculateStatus(top, (Operator)ins.code, b, top);
+                if (status != EVAL_OK) return status;
+                break;
+            }
+        }
+    }
+    
+    result = operandStack.topUnchecked();
+    return EVAL_OK;
+}
+
+// 执行编译后的程序（使用临时求值上下文）
+EvalStatus evaluate(const Program& program, const double* bindings, double& result) {
+    EvalContext context;
+    return evaluate(program, bindings, result, context);
+}
+
+// 按变量名绑定并执行（便捷接口，出错时抛出异常）
+double evaluate(const Program& program, const std::map<std::string, double>& bindings) {
+    std::vector<double> values(program.variables.size());
+    for (size_t i = 0; i < program.variables.size(); i++) {
+        auto it = bindings.find(program.variables[i]);
+        if (it == bindings.end()) {
+            throw std::runtime_error("Unbound variable: " + program.variables[i]);
+        }
+        values[i] = it->second;
+    }
+    
+    double result;
+    EvalStatus status = evaluate(program, values.data(), result);
+    if (status != EVAL_OK) {
+        throw std::runtime_error(evalMessage[status]);
+    }
+    return result;
+}
+
+// ===================== 表达式优化：常量折叠、公共子表达式消除、代数化简 =====================
+
+// 表达式 DAG 的结点
+struct ExprNode {
+    OpCode code;
+    double value; // I_NUM 的常数
+    int arg;      // I_VAR 的变量槽位，I_FUNC 的函数编号
+    int left;     // 一元运算的操作数 / 二元运算的左操作数（-1 表示无）
+    int right;    // 二元运算的右操作数（-1 表示无）
+};
+
+// 程序优化器：把后缀程序还原为 DAG，内容相同的结点只建一次（公共子表达式自然共享），
+// 建结点时折叠常量并做不改变结果的代数化简，最后重新生成后缀程序。
+// 求值会出错的常量子树不折叠，保证优化前后的结果与错误一致
+class ProgramOptimizer {
+private:
+    std::vector<ExprNode> nodes;
+    std::map<std::tuple<int, uint64_t, int, int, int>, int> known; // 结点内容 -> 结点编号
+    
+    int intern(OpCode code, double value, int arg, int left, int right) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto key = std::make_tuple((int)code, bits, arg, left, right);
+        auto it = known.find(key);
+        if (it != known.end()) {
+            return it->second;
+        }
+        nodes.push_back({code, value, arg, left, right});
+        known[key] = (int)nodes.size() - 1;
+        return (int)nodes.size() - 1;
+    }
+    
+    int constant(double value) {
+        return intern(I_NUM, value, 0, -1, -1);
+    }
+    
+    bool isConstant(int node, double& value) const {
+        value = nodes[node].value;
+        return nodes[node].code == I_NUM;
+    }
+    
+    // 一元运算结点：取负、阶乘、函数调用
+    int unary(OpCode code, int arg, int operand) {
+        double v, result;
+        if (isConstant(operand, v)) {
+            if (code == I_NEG) {
+                return constant(-v);
+            }
+            EvalStatus status = code == I_FAC ? factorialStatus(v, result)
+                                              : evaluateFunctionStatus(arg, v, result);
+            if (status == EVAL_OK) {
+                return constant(result);
+            }
+        }
+        if (code == I_NEG && nodes[operand].code == I_NEG) {
+            return nodes[operand].left; // -(-x) -> x
+        }
+        return intern(code, 0, arg, operand, -1);
+    }
+    
+    // 二元运算结点
+    int binary(OpCode code, int left, int right) {
+        double a, b, result;
+        bool constLeft = isConstant(left, a);
+        bool constRight = isConstant(right, b);
+        if (constLeft && constRight && calculateStatus(a, (Operator)code, b, result) == EVAL_OK) {
+            return constant(result);
+        }
+        if (constRight) {
+            if ((code == I_MUL || code == I_DIV || code == I_POW) && b == 1) {
+                return left; // x*1, x/1, x^1 -> x
+            }
+            if (code == I_SUB && b == 0 && !std::signbit(b)) {
+                return left; // x-0 -> x
+            }
+            if (code == I_POW && b == 2) {
+                return binary(I_MUL, left, left); // x^2 -> x*x
+            }
+        }
+        if (constLeft && code == I_MUL && a == 1) {
+            return right; // 1*x -> x
+        }
+        return intern(code, 0, 0, left, right);
+    }
+    
+public:
+    Program optimize(const Program& program) {
+        // 1. 把后缀程序还原为 DAG（输入可能是已优化过的程序，临时槽位记录存入的结点）
+        std::vector<int> stack;
+        std::vector<int> temps(program.numTemps, -1);
+        for (const Instruction& ins : program.code) {
+            switch (ins.code) {
+                case I_NUM:
+                    stack.push_back(constant(ins.value));
+                    break;
+                case I_VAR:
+                    stack.push_back(intern(I_VAR, 0, ins.arg, -1, -1));
+                    break;
+                case I_LOAD:
+                    stack.push_back(temps[ins.arg]);
+                    break;
+                case I_STORE:
+                    temps[ins.arg] = stack.back();
+                    break;
+                case I_NEG:
+                case I_FAC:
+                case I_FUNC:
+                    stack.back() = unary(ins.code, ins.arg, stack.back());
+                    break;
+                default:
+                {
+                    int right = stack.back();
+                    stack.pop_back();
+                    stack.back() = binary(ins.code, stack.back(), right);
+                    break;
+                }
+            }
+        }
+        int root = stack.back();
+        
+        // 2. 统计每个结点被引用的次数
+        std::vector<int> uses(nodes.size(), 0);
+        std::vector<bool> visited(nodes.size(), false);
+        std::vector<int> pending = {root};
+        uses[root] = 1;
+        while (!pending.empty()) {
+            int id = pending.back();
+            pending.pop_back();
+            if (visited[id]) {
+                continue;
+            }
+            visited[id] = true;
+            for (int child : {nodes[id].left, nodes[id].right}) {
+                if (child >= 0) {
+                    uses[child]++;
+                    pending.push_back(child);
+                }
+            }
+        }
+        
+        // 3. 按后序重新生成指令：被多次引用的运算结点第一次计算后存入临时槽位，之后直接读取
+        Program result;
+        result.variables = program.variables;
+        std::vector<int> temp(nodes.size(), -1);
+        std::vector<bool> emitted(nodes.size(), false);
+        std::vector<std::pair<int, bool>> work = {{root, false}};
+        while (!work.empty()) {
+            auto [id, expanded] = work.back();
+            work.pop_back();
+            const ExprNode& node = nodes[id];
+            if (emitted[id] && temp[id] >= 0) {
+                result.code.push_back({I_LOAD, 0, temp[id]});
+            } else if (!expanded && node.left >= 0) {
+                work.push_back({id, true});
+                if (node.right >= 0) {
+                    work.push_back({node.right, false});
+                }
+                work.push_back({node.left, false});
+            } else {
+                result.code.push_back({node.code, node.value, node.arg});
+                emitted[id] = true;
+                if (uses[id] > 1 && node.left >= 0) {
+                    temp[id] = result.numTemps++;
+                    result.code.push_back({I_STORE, 0, temp[id]});
+                }
+            }
+        }
+        
+        // 4. 重新计算所需的栈深度
+        int depth = 0;
+        for (const Instruction& ins : result.code) {
+            if (ins.code == I_NUM || ins.code == I_VAR || ins.code == I_LOAD) {
+                depth++;
+            } else if (ins.code <= I_POW) {
+                depth--;
+            }
+            result.maxDepth = std::max(result.maxDepth, depth);
+        }
+        return result;
+    }
+};
+
+// 优化编译后的程序
+Program optimizeProgram(const Program& program) {
+    PROFILE_PHASE(PHASE_OPTIMIZE);
+    return ProgramOptimizer().optimize(program);
+}
+
+// ===================== 闭包编译：模板特化的表达式树 =====================
+
+// 表达式树结点：每个子表达式编译为一个可直接调用的对象，求值时不再经过指令分派。
+// 结果经返回值（寄存器）传递；出错时只在 status 中记下第一个错误，不中断求值
+struct ClosureNode {
+    virtual ~ClosureNode() {}
+    virtual double eval(const double* vars, EvalStatus& status) const = 0;
+};
+
+// 记录第一个错误
+inline void raise(EvalStatus& status, EvalStatus code) {
+    if (status == EVAL_OK) {
+        status = code;
+    }
+}
+
+// 操作数形态：常数、变量、子表达式，取值方式在编译期确定
+struct ConstOperand {
+    double value;
+    
+    double get(const double*, EvalStatus&) const {
+        return value;
+    }
+};
+
+struct VarOperand {
+    int slot;
+    
+    double get(const double* vars, EvalStatus&) const {
+        return vars[slot];
+    }
+};
+
+struct SubOperand {
+    std::shared_ptr<const ClosureNode> node;
+    
+    double get(const double* vars, EvalStatus& status) const {
+        return node->eval(vars, status);
+    }
+};
+
+// 按运算符特化的二元运算（与 calculateStatus 结果一致）
+template<Operator OP>
+inline double applyBinary(double a, double b, EvalStatus& status) {
+    if constexpr (OP == ADD) {
+        return a + b;
+    } else if constexpr (OP == SUB) {
+        return a - b;
+    } else if constexpr (OP == MUL) {
+        return a * b;
+    } else if constexpr (OP == DIV) {
+        if (b == 0) {
+            raise(status, EVAL_DIV_ZERO);
+        }
+        return a / b;
+    } else {
+        return b == 2 ? a * a : pow(a, b);
+    }
+}
+
+// 链式结点：左深链 ((a op1 b) op2 c)... 展开为对累加值依次执行的步骤，
+// 只有右操作数为子表达式时才递归调用，避免深层递归使返回地址预测失效。
+// 每个步骤是按运算和操作数形态特化的函数
+struct ChainNode final : ClosureNode {
+    struct Step {
+        double (*apply)(const Step& step, double acc, const double* vars, EvalStatus& status);
+        ConstOperand constant;
+        VarOperand variable;
+        SubOperand sub;
+        int func; // 函数调用步骤的函数编号
+    };
+    
+    std::vector<Step> steps;
+    
+    double eval(const double* vars, EvalStatus& status) const override {
+        double acc = 0;
+        for (const Step& step : steps) {
+            acc = step.apply(step, acc, vars, status);
+        }
+        return acc;
+    }
+};
+
+// 取步骤中指定形态的操作数
+template<class A>
+inline const A& operandOf(const ChainNode::Step& step) {
+    if constexpr (std::is_same<A, ConstOperand>::value) {
+        return step.constant;
+    } else if constexpr (std::is_same<A, VarOperand>::value) {
+        return step.variable;
+    } else {
+        return step.sub;
+    }
+}
+
+// 链首步骤：取操作数
+template<class A>
+double loadStep(const ChainNode::Step& step, double, const double* vars, EvalStatus& status) {
+    return operandOf<A>(step).get(vars, status);
+}
+
+// 二元运算步骤：acc = acc op 操作数
+template<Operator OP, class R>
+double binaryStep(const ChainNode::Step& step, double acc, const double* vars, EvalStatus& status) {
+    return applyBinary<OP>(acc, operandOf<R>(step).get(vars, status), status);
+}
+
+// 一元运算步骤：acc = -acc / acc! / func(acc)
+template<OpCode CODE>
+double unaryStep(const ChainNode::Step& step, double acc, const double*, EvalStatus& status) {
+    if constexpr (CODE == I_NEG) {
+        return -acc;
+    } else {
+        double result = NAN;
+        EvalStatus code = CODE == I_FAC ? factorialStatus(acc, result)
+                                        : evaluateFunctionStatus(step.func, acc, result);
+        if (code != EVAL_OK) {
+            raise(status, code);
+        }
+        return result;
+    }
+}
+
+// 闭包编译后的表达式
+struct ClosureProgram {
+    std::shared_ptr<const ClosureNode> root;
+    std::vector<std::string> variables; // 变量槽位 -> 变量名
+};
+
+// 闭包编译器：按后缀程序自底向上构造链式结点。
+// 优化后程序中的公共子表达式在树中共享同一结点，但每次引用都会重新求值
+class ClosureCompiler {
+private:
+    typedef ChainNode::Step Step;
+    
+    typedef enum {OPERAND_CONST, OPERAND_VAR, OPERAND_SUB} OperandKind;
+    
+    struct Operand {
+        OperandKind kind;
+        double value;
+        int slot;
+        std::shared_ptr<ChainNode> chain;
+    };
+    
+    // 按操作数形态生成特化的步骤
+    template<template<class> class StepFor>
+    static Step makeStep(const Operand& operand) {
+        Step step = {nullptr, {operand.value}, {operand.slot}, {operand.chain}, 0};
+        switch (operand.kind) {
+            case OPERAND_CONST: step.apply = StepFor<ConstOperand>::apply; break;
+            case OPERAND_VAR: step.apply = StepFor<VarOperand>::apply; break;
+            default: step.apply = StepFor<SubOperand>::apply; break;
+        }
+        return step;
+    }
+    
+    template<class A>
+    struct LoadFor {
+        static constexpr auto apply = loadStep<A>;
+    };
+    
+    template<Operator OP>
+    struct BinaryFor {
+        template<class R>
+        struct Of {
+            static constexpr auto apply = binaryStep<OP, R>;
+        };
+    };
+    
+    // 取得可追加步骤的链：操作数本身是未被共享的链时直接沿用，否则新建以取数开头的链
+    static std::shared_ptr<ChainNode> chainOf(const Operand& operand) {
+        if (operand.kind == OPERAND_SUB && operand.chain.use_count() == 1) {
+            return operand.chain;
+        }
+        auto chain = std::make_shared<ChainNode>();
+        chain->steps.push_back(makeStep<LoadFor>(operand));
+        return chain;
+    }
+    
+    static Step binaryStepFor(OpCode code, const Operand& right) {
+        switch (code) {
+            case I_ADD: return makeStep<BinaryFor<ADD>::Of>(right);
+            case I_SUB: return makeStep<BinaryFor<SUB>::Of>(right);
+            case I_MUL: return makeStep<BinaryFor<MUL>::Of>(right);
+            case I_DIV: return makeStep<BinaryFor<DIV>::Of>(right);
+            default: return makeStep<BinaryFor<POW>::Of>(right);
+        }
+    }
+    
+    static Step unaryStepFor(OpCode code, int func) {
+        Step step = {nullptr, {0}, {0}, {nullptr}, func};
+        step.apply = code == I_NEG ? unaryStep<I_NEG> : code == I_FAC ? unaryStep<I_FAC> : unaryStep<I_FUNC>;
+        return step;
+    }
+    
+public:
+    static ClosureProgram compile(const Program& program) {
+        std::vector<Operand> stack;
+        std::vector<Operand> temps(program.numTemps);
+        
+        for (const Instruction& ins : program.code) {
+            switch (ins.code) {
+                case I_NUM:
+                    stack.push_back({OPERAND_CONST, ins.value, 0, nullptr});
+                    break;
+                case I_VAR:
+                    stack.push_back({OPERAND_VAR, 0, ins.arg, nullptr});
+                    break;
+                case I_STORE:
+                    temps[ins.arg] = stack.back();
+                    break;
+                case I_LOAD:
+                    stack.push_back(temps[ins.arg]);
+                    break;
+                case I_NEG:
+                case I_FAC:
+                case I_FUNC:
+                {
+                    std::shared_ptr<ChainNode> chain = chainOf(stack.back());
+                    chain->steps.push_back(unaryStepFor(ins.code, ins.arg));
+                    stack.back() = {OPERAND_SUB, 0, 0, chain};
+                    break;
+                }
+                default:
+                {
+                    Operand right = stack.back();
+                    stack.pop_back();
+                    Operand left = stack.back();
+                    stack.back().chain.reset();
+                    std::shared_ptr<ChainNode> chain = chainOf(left);
+                    left.chain.reset();
+                    chain->steps.push_back(binaryStepFor(ins.code, right));
+                    stack.back() = {OPERAND_SUB, 0, 0, chain};
+                    break;
+                }
+            }
+        }
+        
+        ClosureProgram result;
+        result.variables = program.variables;
+        result.root = chainOf(stack.back());
+        return result;
+    }
+};
+
+// 把编译后的程序转换为闭包树
+ClosureProgram compileClosure(const Program& program) {
+    return ClosureCompiler::compile(program);
+}
+
+// 执行闭包树：bindings 按槽位给出变量值
+inline EvalStatus evaluate(const ClosureProgram& program, const double* bindings, double& result) {
+    EvalStatus status = EVAL_OK;
+    result = program.root->eval(bindings, status);
+    return status;
+}
+
+// 执行引擎：字节码解释器或闭包树
+typedef enum {ENGINE_INTERPRETER, ENGINE_CLOSURE} Engine;
+
+// 可选择执行引擎的已编译表达式
+class CompiledExpression {
+private:
+    Engine engine;
+    Program program;
+    ClosureProgram closure;
+    
+public:
+    CompiledExpression(std::string_view expression, Engine selected = ENGINE_INTERPRETER,
+                       const std::vector<std::string>& variables = {})
+        : engine(selected), program(optimizeProgram(compileExpression(expression, variables))) {
+        if (engine == ENGINE_CLOSURE) {
+            closure = compileClosure(program);
+        }
+    }
+    
+    const std::vector<std::string>& variables() const {
+        return program.variables;
+    }
+    
+    EvalStatus evaluate(const double* bindings, double& result, EvalContext& context) const {
+        if (engine == ENGINE_CLOSURE) {
+            return ::evaluate(closure, bindings, result);
+        }
+        return ::evaluate(program, bindings, result, context);
+    }
+};
+
+// ===================== 编译结果缓存 =====================
+
+// 以规范化表达式文本为键的 LRU 缓存（线程安全）。含变量的表达式缓存优化后的编译结果，
+// 不含变量的表达式直接缓存求值结果；按估算的内存占用淘汰最久未使用的条目
+class ExpressionCache {
+public:
+    struct Entry {
+        std::shared_ptr<const Program> program; // 编译结果（常量表达式为空）
+        double value = 0;                       // 常量表达式的结果
+        EvalStatus status = EVAL_OK;            // 常量表达式的求值状态
+        
+        bool constant() const {
+            return !program;
+        }
+    };
+    
+    struct Stats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+    
+    explicit ExpressionCache(size_t memoryBudget = 16 << 20) : budget(memoryBudget) {}
+    
+    // 查找表达式的缓存条目，未命中时编译（编译错误照常抛出，不缓存）
+    std::shared_ptr<const Entry> lookup(std::string_view expression) {
+        PROFILE_PHASE(PHASE_CACHE);
+        thread_local std::string key;
+        normalize(expression, key);
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end()) {
+                hits++;
+                lru.splice(lru.begin(), lru, it->second);
+                return it->second->entry;
+            }
+            misses++;
+        }
+        
+        // 在锁外编译，并发未命中同一表达式时各自编译，先插入者生效
+        auto entry = std::make_shared<Entry>();
+        Program program = optimizeProgram(compileExpression(expression)); // 出错位置对应原文
+        if (program.variables.empty()) {
+            entry->status = ::evaluate(program, nullptr, entry->value);
+        } else {
+            entry->program = std::make_shared<const Program>(std::move(program));
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            return it->second->entry;
+        }
+        lru.push_front({key, entry, footprint(key, *entry)});
+        index[key] = lru.begin();
+        bytes += lru.front().bytes;
+        evictOverBudget();
+        return entry;
+    }
+    
+    // 求不含变量的表达式的值（出错时抛出异常）
+    double evaluate(std::string_view expression) {
+        std::shared_ptr<const Entry> entry = lookup(expression);
+        if (!entry->constant()) {
+            throw std::runtime_error("Unbound variable: " + entry->program->variables[0]);
+        }
+        if (entry->status != EVAL_OK) {
+            throw std::runtime_error(evalMessage[entry->status]);
+        }
+        return entry->value;
+    }
+    
+    // 设置内存预算（字节），超出部分立即淘汰
+    void setMemoryBudget(size_t memoryBudget) {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = memoryBudget;
+        evictOverBudget();
+    }
+    
+    // 清空缓存（如注册了同名函数后），计数器保留
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        lru.clear();
+        index.clear();
+        bytes = 0;
+    }
+    
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {hits, misses, evictions, lru.size(), bytes};
+    }
+    
+    // 规范化：去掉不影响分词的空白，保证规范化前后分词结果相同。空白两侧可能连成
+    // 一个词法单元时（数字、标识符，或负号紧跟数字，如 "1 2"、"s in"、"- 3"）
+    // 保留为一个空格，其余空白删除
+    static void normalize(std::string_view expression, std::string& key) {
+        key.clear();
+        bool space = false;
+        for (char c : expression) {
+            if (std::isspace((unsigned char)c)) {
+                space = !key.empty();
+                continue;
+            }
+            if (space && (joinsToken(key.back()) || key.back() == '-') && joinsToken(c)) {
+                key += ' ';
+            }
+            space = false;
+            key += c;
+        }
+    }
+    
+private:
+    struct Node {
+        std::string key;
+        std::shared_ptr<const Entry> entry;
+        size_t bytes;
+    };
+    
+    // 可与相邻字符组成同一个数字或标识符的字符
+    static bool joinsToken(char c) {
+        return std::isalnum((unsigned char)c) || c == '_' || c == '.';
+    }
+    
+    mutable std::mutex mutex;
+    std::list<Node> lru; // 表头为最近使用
+    std::unordered_map<std::string, std::list<Node>::iterator> index;
+    size_t budget;
+    size_t bytes = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    
+    // 估算一个条目占用的内存
+    static size_t footprint(const std::string& key, const Entry& entry) {
+        size_t size = sizeof(Node) + sizeof(Entry) + 2 * key.size() + 64;
+        if (entry.program) {
+            size += sizeof(Program) + entry.program->code.size() * sizeof(Instruction);
+            for (const std::string& name : entry.program->variables) {
+                size += sizeof(std::string) + name.size();
+            }
+        }
+        return size;
+    }
+    
+    void evictOverBudget() {
+        while (bytes > budget && !lru.empty()) {
+            bytes -= lru.back().bytes;
+            index.erase(lru.back().key);
+            lru.pop_back();
+            evictions++;
+        }
+    }
+};
+
+// 全局编译结果缓存，供 evaluateExtendedExpression 使用
+ExpressionCache& defaultExpressionCache() {
+    static ExpressionCache cache;
+    return cache;
+}
+
+// 扩展版计算器，支持复杂函数：函数调用在编译时作为运算符入栈，一遍扫描完成解析。
+// 编译结果经全局缓存复用，重复出现的表达式无需再次解析
+double evaluateExtendedExpression(const std::string& expression) {
+    if (expression.empty()) {
+        return 0;
+    }
+    PROFILE_EXPRESSION();
+    return defaultExpressionCache().evaluate(expression);
+}
+
+// ===================== 公式表：命名公式的增量重算 =====================
+
+// 公式表：命名公式可引用输入和其他公式（如 a = 2*x+sin(y)），构成依赖 DAG。
+// 输入变化时只按拓扑层次重算受影响的公式；结果不变的公式不再向下传播
+class FormulaSheet {
+private:
+    struct Node {
+        std::string name;
+        bool formula = false;
+        Program program;               // 公式的编译结果
+        std::vector<int> dependencies; // 变量槽位 -> 依赖结点
+        std::vector<int> dependents;   // 直接引用本结点的公式
+        int level = 0;                 // 拓扑层次：输入为 0，公式为依赖的最大层次 + 1
+        double value = NAN;
+        EvalStatus status = EVAL_UNBOUND;
+        bool queued = false;
+    };
+    
+    std::vector<Node> nodes;
+    std::unordered_map<std::string, int> ids;
+    EvalContext context;
+    std::vector<double> bindings;
+    // 待重算队列：按层次从低到高处理，保证依赖先于引用者完成
+    std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>,
+                        std::greater<std::pair<int, int>>> queue;
+    size_t recomputed = 0;
+    
+    int nodeId(const std::string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        nodes.emplace_back();
+        nodes.back().name = name;
+        ids[name] = (int)nodes.size() - 1;
+        return (int)nodes.size() - 1;
+    }
+    
+    const Node& find(const std::string& name) const {
+        auto it = ids.find(name);
+        if (it == ids.end()) {
+            throw std::runtime_error("Unknown name: " + name);
+        }
+        return nodes[it->second];
+    }
+    
+    void enqueue(int id) {
+        if (!nodes[id].queued) {
+            nodes[id].queued = true;
+            queue.push({nodes[id].level, id});
+        }
+    }
+    
+    void enqueueDependents(int id) {
+        for (int dependent : nodes[id].dependents) {
+            enqueue(dependent);
+        }
+    }
+    
+    // 从 from 沿依赖边能否到达 target（用于检测循环引用），path 返回经过的结点
+    bool reaches(int from, int target, std::vector<int>& path) const {
+        std::vector<int> stack = {from};
+        std::vector<int> parent(nodes.size(), -2);
+        parent[from] = -1;
+        while (!stack.empty()) {
+            int id = stack.back();
+            stack.pop_back();
+            if (id == target) {
+                for (int k = id; k >= 0; k = parent[k]) {
+                    path.push_back(k);
+                }
+                return true;
+            }
+            for (int dependency : nodes[id].dependencies) {
+                if (parent[dependency] == -2) {
+                    parent[dependency] = id;
+                    stack.push_back(dependency);
+                }
+            }
+        }
+        return false;
+    }
+    
+    // 公式的依赖变化后，重新计算它及其下游结点的拓扑层次
+    void relevel(int id) {
+        std::vector<int> work = {id};
+        while (!work.empty()) {
+            int current = work.back();
+            work.pop_back();
+            int level = 0;
+            for (int dependency : nodes[current].dependencies) {
+                level = std::max(level, nodes[dependency].level + 1);
+            }
+            if (level != nodes[current].level || current == id) {
+                nodes[current].level = level;
+                work.insert(work.end(), nodes[current].dependents.begin(), nodes[current].dependents.end());
+            }
+        }
+    }
+    
+    void recompute(Node& node) {
+        EvalStatus status = EVAL_OK;
+        for (size_t slot = 0; slot < node.dependencies.size(); slot++) {
+            const Node& dependency = nodes[node.dependencies[slot]];
+            if (dependency.status != EVAL_OK && status == EVAL_OK) {
+                status = dependency.status; // 依赖出错时沿用其错误
+            }
+            bindings[slot] = dependency.value;
+        }
+        double value = NAN;
+        if (status == EVAL_OK) {
+            status = evaluate(node.program, bindings.data(), value, context);
+        }
+        
+        bool changed = status != node.status ||
+                       !(value == node.value || (std::isnan(value) && std::isnan(node.value)));
+        node.value = status == EVAL_OK ? value : NAN;
+        node.status = status;
+        recomputed++;
+        if (changed) {
+            enqueueDependents((int)(&node - nodes.data()));
+        }
+    }
+    
+    // 处理待重算队列
+    void propagate() {
+        recomputed = 0;
+        while (!queue.empty()) {
+            int id = queue.top().second;
+            queue.pop();
+            nodes[id].queued = false;
+            if (nodes[id].formula) {
+                recompute(nodes[id]);
+            }
+        }
+    }
+    
+public:
+    // 定义或重定义公式，形如 "a = 2*x+sin(y)"
+    void define(const std::string& definition) {
+        size_t eq = definition.find('=');
+        if (eq == std::string::npos) {
+            throw std::runtime_error("Invalid definition: missing '='");
+        }
+        std::string name;
+        for (char c : definition.substr(0, eq)) {
+            if (!std::isspace((unsigned char)c)) {
+                name += c;
+            }
+        }
+        define(name, definition.substr(eq + 1));
+    }
+    
+    // 定义或重定义公式 name = expression；出现循环引用时抛出异常，原定义不变
+    void define(const std::string& name, const std::string& expression) {
+        if (name.empty() || !(std::isalpha((unsigned char)name[0]) || name[0] == '_') ||
+            !std::all_of(name.begin(), name.end(),
+                         [](char c) { return std::isalnum((unsigned char)c) || c == '_'; })) {
+            throw std::runtime_error("Invalid formula name: " + name);
+        }
+        Program program = optimizeProgram(compileExpression(expression));
+        
+        int id = nodeId(name);
+        std::vector<int> dependencies;
+        for (const std::string& variable : program.variables) {
+            dependencies.push_back(nodeId(variable));
+        }
+        for (int dependency : dependencies) {
+            std::vector<int> path;
+            if (reaches(dependency, id, path)) {
+                std::string cycle = name;
+                for (auto k = path.rbegin(); k != path.rend(); ++k) {
+                    cycle += " -> " + nodes[*k].name;
+                }
+                throw std::runtime_error("Circular reference: " + cycle);
+            }
+        }
+        
+        // 替换依赖边
+        Node& node = nodes[id];
+        for (int dependency : node.dependencies) {
+            auto& list = nodes[dependency].dependents;
+            list.erase(std::find(list.begin(), list.end(), id));
+        }
+        for (int dependency : dependencies) {
+            nodes[dependency].dependents.push_back(id);
+        }
+        node.formula = true;
+        node.program = std::move(program);
+        node.dependencies = std::move(dependencies);
+        if (bindings.size() < node.dependencies.size()) {
+            bindings.resize(node.dependencies.size());
+        }
+        
+        relevel(id);
+        enqueue(id);
+        propagate();
+    }
+    
+    // 设置单个输入
+    void set(const std::string& input, double value) {
+        update({{input, value}});
+    }
+    
+    // 批量更新输入，全部写入后只做一次重算；任一名字是公式时整批不生效
+    void update(const std::vector<std::pair<std::string, double>>& changes) {
+        for (const auto& change : changes) {
+            auto it = ids.find(change.first);
+            if (it != ids.end() && nodes[it->second].formula) {
+                throw std::runtime_error("Cannot assign to formula: " + change.first);
+            }
+        }
+        for (const auto& change : changes) {
+            int id = nodeId(change.first);
+            Node& node = nodes[id];
+            if (node.status != EVAL_OK || node.value != change.second) {
+                node.value = change.second;
+                node.status = EVAL_OK;
+                enqueueDependents(id);
+            }
+        }
+        propagate();
+    }
+    
+    double value(const std::string& name) const {
+        return find(name).value;
+    }
+    
+    EvalStatus status(const std::string& name) const {
+        return find(name).status;
+    }
+    
+    // 上一次定义或更新中重算的公式个数
+    size_t lastRecomputed() const {
+        return recomputed;
+    }
+};
+
+// ===================== 批量求值：一个表达式作用于多列输入 =====================
+
+#define BATCH_BLOCK 256 //每次按块求值的行数
+
+// SIMD 基本运算：按编译目标选择 AVX-512 / AVX2，否则退化为标量
+#if defined(__AVX512F__)
+#define BATCH_SIMD_NAME "AVX-512"
+#define BATCH_SIMD_WIDTH 8
+typedef __m512d batch_vec;
+inline batch_vec vload(const double* p) { return _mm512_loadu_pd(p); }
+inline void vstore(double* p, batch_vec v) { _mm512_storeu_pd(p, v); }
+inline batch_vec vadd(batch_vec a, batch_vec b) { return _mm512_add_pd(a, b); }
+inline batch_vec vsub(batch_vec a, batch_vec b) { return _mm512_sub_pd(a, b); }
+inline batch_vec vmul(batch_vec a, batch_vec b) { return _mm512_mul_pd(a, b); }
+inline batch_vec vdiv(batch_vec a, batch_vec b) { return _mm512_div_pd(a, b); }
+inline batch_vec vsqrt(batch_vec a) { return _mm512_maskz_sqrt_pd(0xFF, a); }
+inline batch_vec vneg(batch_vec a) {
+    return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(a),
+                                                _mm512_set1_epi64((long long)1 << 63)));
+}
+inline batch_vec vabs(batch_vec a) {
+    return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a),
+                                                _mm512_set1_epi64(~((long long)1 << 63))));
+}
+inline unsigned vzeromask(batch_vec a) { return _mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_EQ_OQ); }
+inline unsigned vnegmask(batch_vec a) { return _mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_LT_OQ); }
+#elif defined(__AVX2__)
+#define BATCH_SIMD_NAME "AVX2"
+#define BATCH_SIMD_WIDTH 4
+typedef __m256d batch_vec;
+inline batch_vec vload(const double* p) { return _mm256_loadu_pd(p); }
+inline void vstore(double* p, batch_vec v) { _mm256_storeu_pd(p, v); }
+inline batch_vec vadd(batch_vec a, batch_vec b) { return _mm256_add_pd(a, b); }
+inline batch_vec vsub(batch_vec a, batch_vec b) { return _mm256_sub_pd(a, b); }
+inline batch_vec vmul(batch_vec a, batch_vec b) { return _mm256_mul_pd(a, b); }
+inline batch_vec vdiv(batch_vec a, batch_vec b) { return _mm256_div_pd(a, b); }
+inline batch_vec vsqrt(batch_vec a) { return _mm256_sqrt_pd(a); }
+inline batch_vec vneg(batch_vec a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+inline batch_vec vabs(batch_vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+inline unsigned vzeromask(batch_vec a) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_EQ_OQ));
+}
+inline unsigned vnegmask(batch_vec a) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_LT_OQ));
+}
+#else
+#define BATCH_SIMD_NAME "scalar"
+#define BATCH_SIMD_WIDTH 1
+typedef double batch_vec;
+inline batch_vec vload(const double* p) { return *p; }
+inline void vstore(double* p, batch_vec v) { *p = v; }
+inline batch_vec vadd(batch_vec a, batch_vec b) { return a + b; }
+inline batch_vec vsub(batch_vec a, batch_vec b) { return a - b; }
+inline batch_vec vmul(batch_vec a, batch_vec b) { return a * b; }
+inline batch_vec vdiv(batch_vec a, batch_vec b) { return a / b; }
+inline batch_vec vsqrt(batch_vec a) { return sqrt(a); }
+inline batch_vec vneg(batch_vec a) { return -a; }
+inline batch_vec vabs(batch_vec a) { return fabs(a); }
+inline unsigned vzeromask(batch_vec a) { return a == 0; }
+inline unsigned vnegmask(batch_vec a) { return a < 0; }
+#endif
+
+// 记录出错行：每行只保留第一个错误
+inline void markRows(unsigned mask, unsigned char* status, EvalStatus code) {
+    while (mask) {
+        int lane = __builtin_ctz(mask);
+        if (status[lane] == EVAL_OK) {
+            status[lane] = code;
+        }
+        mask &= mask - 1;
+    }
+}
+
+// 对一个数据块执行二元运算：a[i] = a[i] op b[i]
+void batchBinary(Operator op, double* a, const double* b, size_t n, unsigned char* status) {
+    const size_t W = BATCH_SIMD_WIDTH;
+    size_t i = 0;
+    switch (op) {
+        case ADD:
+            for (; i + W <= n; i += W) vstore(a + i, vadd(vload(a + i), vload(b + i)));
+            break;
+        case SUB:
+            for (; i + W <= n; i += W) vstore(a + i, vsub(vload(a + i), vload(b + i)));
+            break;
+        case MUL:
+            for (; i + W <= n; i += W) vstore(a + i, vmul(vload(a + i), vload(b + i)));
+            break;
+        case DIV:
+            for (; i + W <= n; i += W) {
+                batch_vec vb = vload(b + i);
+                markRows(vzeromask(vb), status + i, EVAL_DIV_ZERO);
+                vstore(a + i, vdiv(vload(a + i), vb));
+            }
+            break;
+        default: // POW 没有 SIMD 版本，逐行调用 pow
+            break;
+    }
+    // 剩余行（及 POW）逐行计算
+    for (; i < n; i++) {
+        EvalStatus s = calculateStatus(a[i], op, b[i], a[i]);
+        if (s != EVAL_OK) markRows(1, status + i, s);
+    }
+}
+
+// 对一个数据块执行函数运算：a[i] = func(a[i])
+void batchFunction(int func, double* a, size_t n, unsigned char* status) {
+    const size_t W = BATCH_SIMD_WIDTH;
+    size_t i = 0;
+    if (func == F_SQRT) {
+        for (; i + W <= n; i += W) {
+            batch_vec v = vload(a + i);
+            markRows(vnegmask(v), status + i, EVAL_SQRT_DOMAIN);
+            vstore(a + i, vsqrt(v));
+        }
+    } else if (func == F_ABS) {
+        for (; i + W <= n; i += W) vstore(a + i, vabs(vload(a + i)));
+    }
+    // 三角、对数及扩展函数没有 SIMD 版本，逐行调用
+    for (; i < n; i++) {
+        EvalStatus s = evaluateFunctionStatus(func, a[i], a[i]);
+        if (s != EVAL_OK) markRows(1, status + i, s);
+    }
+}
+
+// 对一个数据块取负
+void batchNegate(double* a, size_t n) {
+    const size_t W = BATCH_SIMD_WIDTH;
+    size_t i = 0;
+    for (; i + W <= n; i += W) vstore(a + i, vneg(vload(a + i)));
+    for (; i < n; i++) a[i] = -a[i];
+}
+
+// 批量求值：columns[slot] 指向第 slot 个变量的 rows 个连续取值，结果写入 out。
+// 每行的 EvalStatus 写入 status，出错行的结果为 NaN，单行出错不影响其他行。
+void evaluateBatch(const Program& program, const double* const* columns, size_t rows,
+                   double* out, unsigned char* status) {
+    // 操作数栈的每一层是一个数据块
+    std::vector<double> stack((size_t)(program.maxDepth + program.numTemps) * BATCH_BLOCK);
+    auto block = [&](int level) { return stack.data() + (size_t)level * BATCH_BLOCK; };
+    auto temp = [&](int slot) { return block(program.maxDepth + slot); }; // 临时值数据块
+    
+    for (size_t base = 0; base < rows; base += BATCH_BLOCK) {
+        size_t n = std::min((size_t)BATCH_BLOCK, rows - base);
+        unsigned char* st = status + base;
+        std::fill(st, st + n, (unsigned char)EVAL_OK);
+        int top = -1;
+        
+        for (const Instruction& ins : program.code) {
+            switch (ins.code) {
+                case I_NUM:
+                    top++;
+                    std::fill(block(top), block(top) + n, ins.value);
+                    break;
+                case I_VAR:
+                    top++;
+                    std::copy(columns[ins.arg] + base, columns[ins.arg] + base + n, block(top));
+                    break;
+                case I_STORE:
+                    std::copy(block(top), block(top) + n, temp(ins.arg));
+                    break;
+                case I_LOAD:
+                    top++;
+                    std::copy(temp(ins.arg), temp(ins.arg) + n, block(top));
+                    break;
+                case I_NEG:
+                    batchNegate(block(top), n);
+                    break;
+                case I_FAC:
+                    for (size_t r = 0; r < n; r++) {
+                        double* v = block(top) + r;
+                        EvalStatus s = factorialStatus(*v, *v);
+                        if (s != EVAL_OK) markRows(1, st + r, s);
+                    }
+                    break;
+                case I_FUNC:
+                    batchFunction(ins.arg, block(top), n, st);
+                    break;
+                default:
+                    batchBinary((Operator)ins.code, block(top - 1), block(top), n, st);
+                    top--;
+                    break;
+            }
+        }
+        
+        const double* result = block(0);
+        for (size_t r = 0; r < n; r++) {
+            out[base + r] = st[r] == EVAL_OK ? result[r] : NAN;
+        }
+    }
+}
+
+// ===================== 批处理模式：多线程流式求值 =====================
+
+#define BATCH_CHUNK_SIZE (1 << 20) //每次读入的字节数，按整行切分成数据块
+
+// 将一行的求值结果追加到输出缓冲（与交互模式一样按定点 6 位小数输出）
+void appendLineResult(std::string_view line, ExpressionCache& cache, std::string& out) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    try {
+        PROFILE_EXPRESSION();
+        double value = line.empty() ? 0 : cache.evaluate(line); // 与交互模式相同的求值与报错
+        char buf[400]; // 足以容纳定点格式的任意 double
+        auto res = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::fixed, 6);
+        out.append(buf, res.ptr);
+    } catch (const std::exception& e) {
+        out += "错误: ";
+        out += e.what();
+    }
+    out += '\n';
+}
+
+// 批处理流水线：主线程按块读入，工作线程并行求值，输出线程按输入顺序写出。
+// 已读入但未写出的数据块数有上限，内存占用与输入长度无关
+class BatchPipeline {
+private:
+    struct Chunk {
+        size_t seq;
+        std::string text;
+    };
+    
+    FILE* input;
+    FILE* output;
+    int threads;
+    size_t maxInFlight;
+    
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Chunk> pending;              // 待求值的数据块
+    std::map<size_t, std::string> finished; // 重排序缓冲：已求值、等待按序写出的结果
+    size_t inFlight = 0;                    // 已读入未写出的数据块数
+    size_t submitted = 0;
+    bool closed = false;
+    std::atomic<size_t> lines{0};
+    
+    void submit(std::string text) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return inFlight < maxInFlight; });
+        pending.push_back({submitted++, std::move(text)});
+        inFlight++;
+        changed.notify_all();
+    }
+    
+    void worker() {
+        ExpressionCache cache; // 每个线程独立的缓存，避免锁竞争
+        while (true) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return !pending.empty() || closed; });
+                if (pending.empty()) {
+                    return;
+                }
+                chunk = std::move(pending.front());
+                pending.pop_front();
+            }
+            
+            std::string out;
+            out.reserve(chunk.text.size() * 2);
+            std::string_view text = chunk.text;
+            size_t count = 0;
+            while (!text.empty()) {
+                size_t end = text.find('\n');
+                appendLineResult(text.substr(0, end), cache, out);
+                text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+                count++;
+            }
+            lines += count;
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            finished[chunk.seq] = std::move(out);
+            changed.notify_all();
+        }
+    }
+    
+    void writer() {
+        for (size_t next = 0;; next++) {
+            std::string out;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return finished.count(next) || (closed && next == submitted); });
+                if (!finished.count(next)) {
+                    return;
+                }
+                out = std::move(finished[next]);
+                finished.erase(next);
+                inFlight--;
+                changed.notify_all();
+            }
+            fwrite(out.data(), 1, out.size(), output);
+        }
+    }
+    
+public:
+    BatchPipeline(FILE* in, FILE* out, int threadCount)
+        : input(in), output(out), threads(threadCount), maxInFlight(2 * threadCount + 2) {}
+    
+    // 处理全部输入，返回处理的行数
+    size_t run() {
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) {
+            pool.emplace_back(&BatchPipeline::worker, this);
+        }
+        std::thread output(&BatchPipeline::writer, this);
+        
+        // 按块读入，不完整的末行留到下一块
+        std::vector<char> buffer(BATCH_CHUNK_SIZE);
+        std::string carry;
+        size_t n;
+        while ((n = fread(buffer.data(), 1, buffer.size(), input)) > 0) {
+            size_t last = std::string_view(buffer.data(), n).rfind('\n');
+            if (last == std::string_view::npos) {
+                carry.append(buffer.data(), n);
+                continue;
+            }
+            std::string text = std::move(carry);
+            text.append(buffer.data(), last + 1);
+            carry.assign(buffer.data() + last + 1, n - last - 1);
+            submit(std::move(text));
+        }
+        if (!carry.empty()) {
+            submit(std::move(carry));
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            changed.notify_all();
+        }
+        for (std::thread& t : pool) {
+            t.join();
+        }
+        output.join();
+        fflush(this->output);
+        return lines;
+    }
+};
+
+// 批处理模式：calculator --batch [文件|-] [--threads N]
+// 每行一个表达式，结果按输入顺序逐行写到标准输出，统计信息写到标准错误
+int runBatchMode(int argc, char* argv[]) {
+    std::string path = "-";
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else {
+            path = arg;
+        }
+    }
+    
+    FILE* input = path == "-" ? stdin : fopen(path.c_str(), "rb");
+    if (!input) {
+        std::cerr << "无法打开输入文件: " << path << std::endl;
+        return 1;
+    }
+    static char outputBuffer[1 << 20];
+    setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+    
+    auto start = std::chrono::steady_clock::now();
+    size_t lines = BatchPipeline(input, stdout, threads).run();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (input != stdin) {
+        fclose(input);
+    }
+    
+    std::cerr << "批处理完成: " << lines << " 行, " << threads << " 个线程, 耗时 "
+              << std::fixed << std::setprecision(3) << seconds << "s, "
+              << std::setprecision(0) << lines / std::max(seconds, 1e-9) << " 行/秒" << std::endl;
+    return 0;
+}
+
+// ===================== 服务模式：本地套接字上的流水线求值 =====================
+
+// 输出吞吐量和延迟分位
+void printLatencyReport(const std::string& title, const LatencyHistogram& histogram, double seconds) {
+    std::cerr << title << ": " << histogram.count() << " 个请求, 耗时 " << std::fixed << std::setprecision(3)
+              << seconds << "s, " << std::setprecision(0) << histogram.count() / std::max(seconds, 1e-9)
+              << " 请求/秒, p50 " << std::setprecision(1) << histogram.percentile(0.50) / 1000.0
+              << "us, p99 " << histogram.percentile(0.99) / 1000.0 << "us, max "
+              << histogram.max() / 1000.0 << "us" << std::endl;
+}
+
+#ifdef __linux__
+
+#define SERVER_DEFAULT_PORT 7878   //默认监听端口（仅回环地址）
+#define SERVER_MAX_FRAME (1 << 20) //单个请求的最大字节数
+#define SERVER_BATCH_SIZE 256      //一次交给求值线程的最大请求数
+#define SERVER_MAX_PENDING 64      //每个连接未完成的批次上限，超过后暂停读取
+
+// 协议：每个请求和响应都是一帧，4 字节小端长度 + 内容；
+// 请求内容是表达式，响应内容与批处理模式的输出行相同（不含换行）。
+// 客户端可以连续发送多帧而不等待响应，响应按请求顺序返回
+void appendFrame(std::string& out, std::string_view payload) {
+    uint32_t n = (uint32_t)payload.size();
+    char header[4] = {(char)(n & 0xff), (char)((n >> 8) & 0xff), (char)((n >> 16) & 0xff), (char)(n >> 24)};
+    out.append(header, 4);
+    out.append(payload.data(), payload.size());
+}
+
+uint32_t frameLength(const char* header) {
+    const unsigned char* p = (const unsigned char*)header;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 服务地址：指定 --unix 时使用 Unix 域套接字，否则使用回环 TCP
+struct ServerAddress {
+    std::string unixPath;
+    int port = SERVER_DEFAULT_PORT;
+    
+    // 解析 argv[i] 处的地址参数，成功时消耗参数并返回 true
+    bool parse(int argc, char* argv[], int& i) {
+        std::string arg = argv[i];
+        if (arg == "--unix" && i + 1 < argc) {
+            unixPath = argv[++i];
+            return true;
+        }
+        if (arg == "--port" && i + 1 < argc) {
+            port = atoi(argv[++i]);
+            return true;
+        }
+        return false;
+    }
+    
+    std::string describe() const {
+        return unixPath.empty() ? "127.0.0.1:" + std::to_string(port) : unixPath;
+    }
+    
+    // 创建已连接（connect 为真）或正在监听的套接字，失败时抛出异常
+    int open(bool connect) const {
+        int fd;
+        int result;
+        if (unixPath.empty()) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons((uint16_t)port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            if (connect) {
+                result = ::connect(fd, (sockaddr*)&addr, sizeof(addr));
+            } else {
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                result = bind(fd, (sockaddr*)&addr, sizeof(addr));
+            }
+        } else {
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            if (unixPath.size() >= sizeof(addr.sun_path)) {
+                ::close(fd);
+                throw std::runtime_error("Socket path too long: " + unixPath);
+            }
+            strcpy(addr.sun_path, unixPath.c_str());
+            if (connect) {
+                result = ::connect(fd, (sockaddr*)&addr, sizeof(addr));
+            } else {
+                unlink(unixPath.c_str());
+                result = bind(fd, (sockaddr*)&addr, sizeof(addr));
+            }
+        }
+        if (result == 0 && !connect) {
+            result = listen(fd, 128);
+        }
+        if (fd < 0 || result != 0) {
+            std::string error = strerror(errno);
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::runtime_error("Cannot " + std::string(connect ? "connect to " : "listen on ") +
+                                     describe() + ": " + error);
+        }
+        return fd;
+    }
+};
+
+// 求值服务：一个 epoll I/O 线程负责所有连接的读写，把完整的请求帧按批交给求值线程池；
+// 求值结果经 eventfd 通知回 I/O 线程，按每个连接的批次序号重排后写回
+class CalcServer {
+private:
+    typedef std::chrono::steady_clock Clock;
+    
+    struct Batch {
+        uint64_t connection;
+        uint64_t seq;
+        size_t count;
+        std::string frames; // 请求帧（原样），求值后替换为响应帧
+        Clock::time_point received;
+    };
+    
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t outOffset = 0;
+        uint64_t nextSeq = 0;   // 下一个提交的批次
+        uint64_t nextWrite = 0; // 下一个写回的批次
+        std::map<uint64_t, std::string> done; // 已求值、等待按序写回的批次
+        uint32_t events = 0;
+        bool peerClosed = false;
+    };
+    
+    enum { TAG_LISTEN, TAG_WAKE, TAG_SIGNAL, TAG_FIRST_CONNECTION };
+    
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    int signalFd;
+    int threads;
+    std::unordered_map<uint64_t, Connection> connections;
+    uint64_t nextConnection = TAG_FIRST_CONNECTION;
+    
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Batch> pending;   // 待求值批次
+    std::vector<Batch> complete; // 已求值、等待 I/O 线程取走的批次
+    bool stopping = false;
+    
+    LatencyHistogram latency; // 仅由 I/O 线程访问
+    size_t accepted = 0;
+    Clock::time_point firstRequest; // 吞吐量按首个请求到最后一个响应计算
+    Clock::time_point lastResponse;
+    
+    void watch(int fd, uint64_t tag, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = tag;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    
+    void worker() {
+        ExpressionCache cache; // 每个线程独立的缓存，避免锁竞争
+        std::string line;
+        while (true) {
+            Batch batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return !pending.empty() || stopping; });
+                if (pending.empty()) {
+                    return;
+                }
+                batch = std::move(pending.front());
+                pending.pop_front();
+            }
+            
+            std::string out;
+            out.reserve(batch.count * 16);
+            for (size_t offset = 0; offset < batch.frames.size();) {
+                uint32_t n = frameLength(batch.frames.data() + offset);
+                line.clear();
+                appendLineResult(std::string_view(batch.frames).substr(offset + 4, n), cache, line);
+                line.pop_back(); // 去掉换行
+                appendFrame(out, line);
+                offset += 4 + n;
+            }
+            batch.frames = std::move(out);
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                complete.push_back(std::move(batch));
+            }
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        }
+    }
+    
+    // 更新连接关注的事件：未完成批次过多时暂停读取，有待写数据时关注可写
+    void updateEvents(uint64_t id, Connection& c) {
+        uint32_t events = EPOLLRDHUP;
+        if (!c.peerClosed && c.nextSeq - c.nextWrite < SERVER_MAX_PENDING) {
+            events |= EPOLLIN;
+        }
+        if (c.outOffset < c.out.size()) {
+            events |= EPOLLOUT;
+        }
+        if (events != c.events) {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.u64 = id;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+            c.events = events;
+        }
+    }
+    
+    void close(uint64_t id) {
+        auto it = connections.find(id);
+        ::close(it->second.fd);
+        connections.erase(it);
+    }
     
-    // 处理负号
-    if (i < expr.length() && expr[i] == '-' && 
-        (i == 1 || expr[i-1] == '(' || expr[i-1] == '+' || expr[i-1] == '-' || 
-         expr[i-1] == '*' || expr[i-1] == '/' || expr[i-1] == '^')) {
-        numStr += expr[i];
-        i++;
+    // 把输入缓冲中的完整请求帧切成批次提交；返回 false 表示协议错误
+    bool submitFrames(uint64_t id, Connection& c) {
+        size_t offset = 0;
+        std::vector<Batch> batches;
+        while (c.nextSeq - c.nextWrite < SERVER_MAX_PENDING) {
+            size_t start = offset;
+            size_t count = 0;
+            while (count < SERVER_BATCH_SIZE && c.in.size() - offset >= 4) {
+                uint32_t n = frameLength(c.in.data() + offset);
+                if (n > SERVER_MAX_FRAME) {
+                    return false;
+                }
+                if (c.in.size() - offset - 4 < n) {
+                    break;
+                }
+                offset += 4 + n;
+                count++;
+            }
+            if (count == 0) {
+                break;
+            }
+            batches.push_back({id, c.nextSeq++, count, c.in.substr(start, offset - start), Clock::now()});
+        }
+        c.in.erase(0, offset);
+        
+        if (!batches.empty()) {
+            if (firstRequest == Clock::time_point()) {
+                firstRequest = batches.front().received;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Batch& batch : batches) {
+                pending.push_back(std::move(batch));
+            }
+            changed.notify_all();
+        }
+        return true;
     }
     
-    // 收集数字字符（包括小数点）
-    while (i < expr.length() && (isDigit(expr[i]) || expr[i] == '.')) {
-        numStr += expr[i];
-        i++;
+    // 尽量写出输出缓冲；返回 false 表示连接已断开
+    bool flush(Connection& c) {
+        while (c.outOffset < c.out.size()) {
+            ssize_t n = send(c.fd, c.out.data() + c.outOffset, c.out.size() - c.outOffset, MSG_NOSIGNAL);
+            if (n < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            c.outOffset += n;
+        }
+        c.out.clear();
+        c.outOffset = 0;
+        return true;
     }
     
-    if (numStr.empty()) {
-        throw std::runtime_error("Invalid number format");
+    // 连接上的读写事件
+    void onConnection(uint64_t id, uint32_t events) {
+        Connection& c = connections[id];
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            char buffer[65536];
+            while (true) {
+                ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    c.in.append(buffer, n);
+                    continue;
+                }
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    c.peerClosed = true;
+                }
+                break;
+            }
+            if (!submitFrames(id, c)) {
+                close(id);
+                return;
+            }
+        }
+        if (!flush(c)) {
+            close(id);
+            return;
+        }
+        finish(id, c);
     }
     
-    try {
-        double num = std::stod(numStr);
-        return std::make_pair(num, i);
-    } catch (...) {
-        throw std::runtime_error("Invalid number format");
+    // 对端已关闭且所有响应已写出时关闭连接，否则更新关注的事件
+    void finish(uint64_t id, Connection& c) {
+        if (c.peerClosed && c.nextWrite == c.nextSeq && c.out.empty()) {
+            close(id);
+        } else {
+            updateEvents(id, c);
+        }
     }
-}
-
-// 字符串计算器主函数（基础运算）
-double evaluateBasicExpression(const std::string& expression) {
-    if (expression.empty()) {
-        return 0;
+    
+    // 取走求值完成的批次，按序追加到各连接的输出缓冲
+    void onComplete() {
+        uint64_t value;
+        ssize_t ignored = read(wakeFd, &value, sizeof(value));
+        (void)ignored;
+        std::vector<Batch> batches;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batches.swap(complete);
+        }
+        
+        Clock::time_point now = Clock::now();
+        lastResponse = now;
+        std::vector<uint64_t> touched;
+        for (Batch& batch : batches) {
+            latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - batch.received).count(),
+                           batch.count);
+            auto it = connections.find(batch.connection);
+            if (it == connections.end()) {
+                continue; // 连接已关闭
+            }
+            it->second.done[batch.seq] = std::move(batch.frames);
+            touched.push_back(batch.connection);
+        }
+        
+        for (uint64_t id : touched) {
+            auto it = connections.find(id);
+            if (it == connections.end()) {
+                continue;
+            }
+            Connection& c = it->second;
+            for (auto next = c.done.find(c.nextWrite); next != c.done.end(); next = c.done.find(c.nextWrite)) {
+                c.out += next->second;
+                c.done.erase(next);
+                c.nextWrite++;
+            }
+            // 暂停读取期间缓冲中可能积压了完整请求
+            if (!submitFrames(id, c) || !flush(c)) {
+                close(id);
+                continue;
+            }
+            finish(id, c);
+        }
     }
     
-    // 添加起始符和终止符
-    std::string expr = '\0' + expression + '\0';
+    void onAccept() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Unix 域套接字上无效，忽略错误
+            uint64_t id = nextConnection++;
+            Connection& c = connections[id];
+            c.fd = fd;
+            c.events = EPOLLIN | EPOLLRDHUP;
+            watch(fd, id, c.events);
+            accepted++;
+        }
+    }
     
-    Stack<double> operandStack; // 操作数栈
-    Stack<Operator> operatorStack; // 运算符栈
-    operatorStack.push(char2optr('\0')); // 先压入起始符
+public:
+    CalcServer(const ServerAddress& address, int threadCount) : threads(threadCount) {
+        // 由 signalfd 接收中断信号；须在创建线程前屏蔽，线程继承信号掩码
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        
+        listenFd = address.open(false);
+        fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        watch(listenFd, TAG_LISTEN, EPOLLIN);
+        watch(wakeFd, TAG_WAKE, EPOLLIN);
+        watch(signalFd, TAG_SIGNAL, EPOLLIN);
+    }
     
-    int i = 1; // 从第一个实际字符开始（跳过起始符）
+    ~CalcServer() {
+        for (auto& connection : connections) {
+            ::close(connection.second.fd);
+        }
+        ::close(listenFd);
+        ::close(wakeFd);
+        ::close(signalFd);
+        ::close(epollFd);
+    }
     
-    while (i < expr.length()) {
-        if (isDigit(expr[i]) || 
-            (expr[i] == '-' && (i == 1 || expr[i-1] == '\0' || expr[i-1] == '(' || 
-                                expr[i-1] == '+' || expr[i-1] == '-' || 
-                                expr[i-1] == '*' || expr[i-1] == '/' || expr[i-1] == '^'))) {
-            // 是数字（包括负数）
-            auto numInfo = getNextNumber(expr, i);
-            operandStack.push(numInfo.first);
-            i = numInfo.second;
-        } else {
-            // 是运算符
-            Operator currOp = char2optr(expr[i]);
-            
-            if (currOp == EOE) {
-                // 终止符，跳出循环
-                break;
-            }
-            
-            switch (getPriority(operatorStack.top(), currOp)) {
-                case '<': // 栈顶运算符优先级低，入栈
-                    operatorStack.push(currOp);
-                    i++;
-                    break;
-                    
-                case '=': // 优先级相等，脱括号
-                    operatorStack.pop(); // 弹出左括号或匹配的运算符
-                    i++;
-                    break;
-                    
-                case '>': // 栈顶运算符优先级高，计算
-                {
-                    Operator op = operatorStack.top();
-                    operatorStack.pop();
-                    
-                    if (op == FAC) {
-                        // 阶乘是一元运算
-                        if (operandStack.empty()) {
-                            throw std::runtime_error("Invalid factorial operation");
-                        }
-                        double operand = operandStack.top();
-                        operandStack.pop();
-                        double result = calculate(op, operand);
-                        operandStack.push(result);
-                    } else {
-                        // 二元运算
-                        if (operandStack.size() < 2) {
-                            throw std::runtime_error("Invalid expression: not enough operands");
-                        }
-                        double b = operandStack.top();
-                        operandStack.pop();
-                        double a = operandStack.top();
-                        operandStack.pop();
-                        double result = calculate(a, op, b);
-                        operandStack.push(result);
-                    }
+    // 运行直到收到 SIGINT/SIGTERM 或超过 duration 秒（0 表示不限），结束时输出统计
+    void run(double duration) {
+        std::vector<std::thread> pool;
+        for (int t = 0; t < threads; t++) {
+            pool.emplace_back(&CalcServer::worker, this);
+        }
+        
+        Clock::time_point deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                                 std::chrono::duration<double>(duration));
+        epoll_event events[256];
+        bool running = true;
+        while (running) {
+            int timeout = -1;
+            if (duration > 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+                if (left <= 0) {
                     break;
                 }
-                
-                default:
-                    throw std::runtime_error("Invalid priority relation");
+                timeout = (int)left;
+            }
+            int n = epoll_wait(epollFd, events, 256, timeout);
+            for (int i = 0; i < n; i++) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == TAG_LISTEN) {
+                    onAccept();
+                } else if (tag == TAG_WAKE) {
+                    onComplete();
+                } else if (tag == TAG_SIGNAL) {
+                    running = false;
+                } else if (connections.count(tag)) {
+                    onConnection(tag, events[i].events);
+                }
             }
         }
-    }
-    
-    // 处理栈中剩余的运算
-    while (operatorStack.top() != char2optr('\0')) {
-        Operator op = operatorStack.top();
-        operatorStack.pop();
         
-        if (op == FAC) {
-            // 阶乘是一元运算
-            if (operandStack.empty()) {
-                throw std::runtime_error("Invalid factorial operation");
-            }
-            double operand = operandStack.top();
-            operandStack.pop();
-            double result = calculate(op, operand);
-            operandStack.push(result);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            changed.notify_all();
+        }
+        for (std::thread& t : pool) {
+            t.join();
+        }
+        double seconds = std::chrono::duration<double>(lastResponse - firstRequest).count();
+        std::cerr << "服务结束: " << accepted << " 个连接" << std::endl;
+        printLatencyReport("服务端", latency, seconds);
+    }
+};
+
+// 服务模式：calculator --server [--unix 路径 | --port 端口] [--threads N] [--duration 秒]
+int runServerMode(int argc, char* argv[]) {
+    ServerAddress address;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    double duration = 0;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (address.parse(argc, argv, i)) {
+            continue;
+        }
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--duration" && i + 1 < argc) {
+            duration = atof(argv[++i]);
         } else {
-            // 二元运算
-            if (operandStack.size() < 2) {
-                throw std::runtime_error("Invalid expression: not enough operands");
-            }
-            double b = operandStack.top();
-            operandStack.pop();
-            double a = operandStack.top();
-            operandStack.pop();
-            double result = calculate(a, op, b);
-            operandStack.push(result);
+            std::cerr << "未知参数: " << arg << std::endl;
+            return 1;
         }
     }
     
-    if (operandStack.size() != 1) {
-        throw std::runtime_error("Invalid expression");
+    try {
+        CalcServer server(address, threads);
+        std::cerr << "服务已启动: " << address.describe() << ", " << threads << " 个求值线程" << std::endl;
+        server.run(duration);
+    } catch (const std::exception& e) {
+        std::cerr << "错误: " << e.what() << std::endl;
+        return 1;
     }
-    
-    return operandStack.top();
+    if (!address.unixPath.empty()) {
+        unlink(address.unixPath.c_str());
+    }
+    return 0;
 }
 
-// 前向声明
-double evaluateExtendedExpression(const std::string& expression);
+std::string randomExpression(std::mt19937& gen, int depth, bool extended);
 
-// 更完善的函数表达式解析器
-class FunctionParser {
-public:
-    static double evaluateFunction(const std::string& func_name, double arg) {
-        if (func_name == "sin") {
-            return sin(arg * M_PI / 180); // 假设输入为度数
-        } else if (func_name == "cos") {
-            return cos(arg * M_PI / 180); // 假设输入为度数
-        } else if (func_name == "tan") {
-            return tan(arg * M_PI / 180); // 假设输入为度数
-        } else if (func_name == "log") {
-            if (arg <= 0) throw std::runtime_error("Log of non-positive number");
-            return log10(arg);
-        } else if (func_name == "ln") {
-            if (arg <= 0) throw std::runtime_error("Ln of non-positive number");
-            return log(arg);
-        } else if (func_name == "sqrt") {
-            if (arg < 0) throw std::runtime_error("Square root of negative number");
-            return sqrt(arg);
-        } else if (func_name == "abs") {
-            return abs(arg);
+// 负载生成：calculator --loadgen [--unix 路径 | --port 端口] [--connections C] [--requests N] [--pipeline D]
+// 每个连接保持最多 D 个未响应的请求，共发送 N 个随机表达式；响应与本地求值结果逐一核对
+int runLoadGenerator(int argc, char* argv[]) {
+    typedef std::chrono::steady_clock Clock;
+    ServerAddress address;
+    int connections = 4;
+    size_t requests = 200000;
+    size_t pipeline = 32;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (address.parse(argc, argv, i)) {
+            continue;
+        }
+        if (arg == "--connections" && i + 1 < argc) {
+            connections = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--requests" && i + 1 < argc) {
+            requests = std::max(1L, atol(argv[++i]));
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            pipeline = std::max(1, atoi(argv[++i]));
         } else {
-            throw std::runtime_error("Unknown function: " + func_name);
+            std::cerr << "未知参数: " << arg << std::endl;
+            return 1;
         }
     }
     
-    // 解析包含函数的表达式
-    static std::string parseAndReplaceFunctions(const std::string& expression) {
-        std::string result = expression;
-        bool changed = true;
-        
-        while (changed) {
-            changed = false;
-            
-            // 查找并替换函数调用（按函数名长度降序，避免短名称干扰长名称）
-            std::vector<std::string> functions = {"sin", "cos", "tan", "log", "ln", "sqrt", "abs"};
+    // 预先生成表达式及其期望响应
+    std::mt19937 gen(12345);
+    std::vector<std::string> expressions(1024);
+    std::vector<std::string> expected(expressions.size());
+    ExpressionCache cache;
+    for (size_t k = 0; k < expressions.size(); k++) {
+        expressions[k] = randomExpression(gen, 4, false);
+        appendLineResult(expressions[k], cache, expected[k]);
+        expected[k].pop_back();
+    }
+    
+    std::vector<LatencyHistogram> histograms(connections);
+    std::atomic<size_t> mismatches(0);
+    std::atomic<int> failures(0);
+    auto client = [&](int index) {
+        int fd;
+        try {
+            fd = address.open(true);
+        } catch (const std::exception& e) {
+            std::cerr << "错误: " << e.what() << std::endl;
+            failures++;
+            return;
+        }
+        size_t quota = requests / connections + ((size_t)index < requests % connections ? 1 : 0);
+        std::vector<Clock::time_point> sentAt(pipeline);
+        std::vector<size_t> sentExpr(pipeline);
+        std::string out;
+        std::string in;
+        char buffer[65536];
+        size_t sent = 0;
+        size_t received = 0;
+        while (received < quota) {
+            // 补满流水线窗口
+            out.clear();
+            while (sent < quota && sent - received < pipeline) {
+                size_t k = (sent * connections + index) % expressions.size();
+                appendFrame(out, expressions[k]);
+                sentExpr[sent % pipeline] = k;
+                sentAt[sent % pipeline] = Clock::now();
+                sent++;
+            }
+            for (size_t offset = 0; offset < out.size();) {
+                ssize_t n = send(fd, out.data() + offset, out.size() - offset, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    failures++;
+                    ::close(fd);
+                    return;
+                }
+                offset += n;
+            }
             
-            for (const std::string& func : functions) {
-                size_t pos = 0;
-                while ((pos = result.find(func, pos)) != std::string::npos) {
-                    // 检查函数名后是否跟着左括号
-                    size_t func_end = pos + func.length();
-                    if (func_end < result.length() && result[func_end] == '(') {
-                        size_t start_pos = pos;
-                        size_t paren_count = 0;
-                        size_t i = func_end + 1; // 跳过左括号
-                        
-                        // 找到匹配的右括号，处理嵌套括号
-                        while (i < result.length()) {
-                            if (result[i] == '(') {
-                                paren_count++;
-                            } else if (result[i] == ')') {
-                                if (paren_count == 0) {
-                                    // 找到匹配的右括号
-                                    std::string arg_str = result.substr(func_end + 1, i - func_end - 1);
-                                    try {
-                                        // 递归解析参数表达式
-                                        double arg_value = evaluateExtendedExpression(arg_str);
-                                        double func_result = evaluateFunction(func, arg_value);
-                                        
-                                        // 替换整个函数调用
-                                        std::string replacement = std::to_string(func_result);
-                                        result.replace(start_pos, i - start_pos + 1, replacement);
-                                        
-                                        changed = true;
-                                        pos = start_pos + replacement.length();
-                                        break; // 从新位置继续搜索
-                                    } catch (const std::exception& e) {
-                                        // 如果参数解析失败，移到下一个可能的位置
-                                        pos = i + 1;
-                                        break;
-                                    }
-                                } else {
-                                    paren_count--;
-                                }
-                            }
-                            i++;
-                        }
-                        
-                        if (i >= result.length()) {
-                            pos = func_end + 1; // 没有找到匹配括号，移到下一个位置
-                        }
-                    } else {
-                        pos++; // 函数名后没有左括号，移到下一个位置
-                    }
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) {
+                failures++;
+                ::close(fd);
+                return;
+            }
+            in.append(buffer, n);
+            Clock::time_point now = Clock::now();
+            size_t offset = 0;
+            while (in.size() - offset >= 4 && in.size() - offset - 4 >= frameLength(in.data() + offset)) {
+                uint32_t length = frameLength(in.data() + offset);
+                size_t slot = received % pipeline;
+                if (std::string_view(in).substr(offset + 4, length) != expected[sentExpr[slot]]) {
+                    mismatches++;
                 }
+                histograms[index].record(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - sentAt[slot]).count());
+                received++;
+                offset += 4 + length;
             }
+            in.erase(0, offset);
         }
-        
+        ::close(fd);
+    };
+    
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < connections; c++) {
+        threads.emplace_back(client, c);
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    
+    LatencyHistogram total;
+    for (const LatencyHistogram& histogram : histograms) {
+        total.merge(histogram);
+    }
+    std::cerr << "负载: " << address.describe() << ", " << connections << " 个连接, 流水线深度 " << pipeline
+              << std::endl;
+    printLatencyReport("客户端", total, seconds);
+    std::cerr << "结果校验: " << mismatches << " 个不一致, " << failures << " 个连接失败" << std::endl;
+    return mismatches == 0 && failures == 0 ? 0 : 1;
+}
+
+#else
+
+int runServerMode(int, char*[]) {
+    std::cerr << "服务模式仅支持 Linux" << std::endl;
+    return 1;
+}
+
+int runLoadGenerator(int, char*[]) {
+    std::cerr << "服务模式仅支持 Linux" << std::endl;
+    return 1;
+}
+
+#endif
+
+// ===================== 性能测试 =====================
+
+volatile double benchmarkSink; // 防止被测代码被优化掉
+
+// 重复执行 body(i)，返回每次调用的平均纳秒数
+template<typename Body>
+double measureNs(size_t iterations, Body body) {
+    double sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        sum += body(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    benchmarkSink = sum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+// 输出一行对比结果
+void printBenchmark(const std::string& name, double baselineNs, double currentNs) {
+    std::cout << name << ": 基准 " << std::fixed << std::setprecision(2) << baselineNs
+              << " ns, 新实现 " << currentNs << " ns, 加速比 " << baselineNs / currentNs << "x" << std::endl;
+}
+
+// 原实现：逐项连乘的阶乘
+double loopFactorial(double n) {
+    double result = 1;
+    for (int i = 2; i <= (int)n; i++) {
+        result *= i;
+    }
+    return result;
+}
+
+// 数学函数性能测试：与原实现（逐项连乘、每次换算弧度并调用 libm）比较
+void benchmarkMathKernels() {
+    const size_t iterations = 2000000;
+    std::cout << "\n数学函数（每次调用）：" << std::endl;
+    
+    auto loopFac = measureNs(iterations, [](size_t i) { return loopFactorial((double)(i % 171)); });
+    auto tableFac = measureNs(iterations, [](size_t i) {
+        double result;
+        factorialStatus((double)(i % 171), result);
         return result;
+    });
+    printBenchmark("n! (n = 0..170)", loopFac, tableFac);
+    
+    for (int func = F_SIN; func <= F_TAN; func++) {
+        auto libm = measureNs(iterations, [func](size_t i) {
+            double arg = (double)(i % 720) - 360;
+            return func == F_SIN ? sin(arg * M_PI / 180)
+                 : func == F_COS ? cos(arg * M_PI / 180) : tan(arg * M_PI / 180);
+        });
+        auto table = measureNs(iterations, [func](size_t i) {
+            double result;
+            builtinFunction((Function)func, (double)(i % 720) - 360, result);
+            return result;
+        });
+        printBenchmark(std::string(funcName[func]) + "(整数度数)", libm, table);
     }
-};
+}
 
-// 扩展版计算器，支持复杂函数
-double evaluateExtendedExpression(const std::string& expression) {
-    // 先解析并替换函数调用
-    std::string processed_expr = FunctionParser::parseAndReplaceFunctions(expression);
+// 执行引擎性能测试：深层（长链）与宽型（多项求和）表达式
+void benchmarkEngines() {
+    std::string deep = "x";
+    const char* steps[] = {"+1.5)", "*y)", "-0.25)", "/1.125)", "+y)", "*0.5)"};
+    for (int k = 0; k < 60; k++) {
+        deep = "(" + deep + steps[k % 6];
+    }
+    std::string wide;
+    for (int k = 0; k < 32; k++) {
+        wide += (k ? "+" : "") + std::string("(x*") + std::to_string(k + 1) + ".5-y/" +
+                std::to_string(k + 2) + ")";
+    }
+    
+    std::cout << "\n执行引擎（每次求值）：" << std::endl;
+    const size_t iterations = 200000;
+    for (const auto& test : {std::make_pair(std::string("深层表达式（60 层）"), deep),
+                             std::make_pair(std::string("宽型表达式（32 项）"), wide)}) {
+        CompiledExpression interpreter(test.second, ENGINE_INTERPRETER, {"x", "y"});
+        CompiledExpression closure(test.second, ENGINE_CLOSURE, {"x", "y"});
+        EvalContext context;
+        auto run = [&](const CompiledExpression& expr) {
+            return measureNs(iterations, [&](size_t i) {
+                double bindings[] = {(double)(i & 1023) * 0.01, 1.0 + (double)(i & 7) * 0.125};
+                double result = 0;
+                expr.evaluate(bindings, result, context);
+                return result;
+            });
+        };
+        printBenchmark(test.first + " 解释器 -> 闭包树", run(interpreter), run(closure));
+    }
+}
+
+// 性能测试模式：calculator --bench
+int runBenchmarks() {
+    std::cout << "=== 计算器性能测试 ===" << std::endl;
+    benchmarkMathKernels();
+    benchmarkEngines();
+    return 0;
+}
+
+// 生成随机表达式（差分测试用）；extended 为真时包含变量 x 和函数调用
+std::string randomExpression(std::mt19937& gen, int depth, bool extended) {
+    std::uniform_int_distribution<int> pick(0, 9);
+    if (depth == 0 || pick(gen) < 2) {
+        int kind = pick(gen);
+        if (kind < 2) {
+            return std::to_string(pick(gen) % 6) + "!";
+        }
+        if (kind < 4 && extended) {
+            return "x";
+        }
+        std::string number = std::to_string(pick(gen));
+        if (kind < 6) {
+            number += ".5";
+        }
+        return kind % 3 == 0 ? "-" + number : number;
+    }
     
-    // 然后用基础计算器计算结果
-    return evaluateBasicExpression(processed_expr);
+    const char ops[] = {'+', '-', '*', '/', '^'};
+    int kind = pick(gen);
+    if (kind < 2 && extended) {
+        return std::string(funcName[pick(gen) % N_FUNC]) + "(" +
+               randomExpression(gen, depth - 1, extended) + ")";
+    }
+    std::string expr = randomExpression(gen, depth - 1, extended) + ops[pick(gen) % 5] +
+                       randomExpression(gen, depth - 1, extended);
+    return kind < 6 ? "(" + expr + ")" : expr;
+}
+
+#ifdef CALC_COUNT_ALLOCS
+
+// 堆分配计数，用于验证求值热路径不分配内存（仅测试构建，编译时加 -DCALC_COUNT_ALLOCS）
+std::atomic<size_t> heapAllocations(0);
+
+// 替换全局 operator new/delete（不内联，以免编译器误报 new/free 不匹配）
+__attribute__((noinline)) void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
 }
 
+#endif
+
 // 测试函数
 void runTests() {
     std::cout << "=== 字符串计算器测试 ===" << std::endl;
@@ -428,6 +3379,8 @@ void runTests() {
         "2)",            // 缺少左括号
         "(2+3",          // 缺少右括号
         "5!",            // 有效阶乘
+        "1.2.3+4",       // 数字格式错误（报告出错位置）
+        "2 * 3 # 4",     // 非法字符
     };
     
     for (const auto& test : errorCases) {
@@ -449,6 +3402,7 @@ void runTests() {
         "ln(2.718)",    // ln(e) ≈ 1
         "sqrt(16)",     // sqrt(16) = 4
         "abs(-5)",      // abs(-5) = 5
+        "abs(-2.5)",    // abs(-2.5) = 2.5（非整数参数）
     };
     
     for (const auto& test : functionTests) {
@@ -475,9 +3429,289 @@ void runTests() {
             std::cout << test << " -> 错误: " << e.what() << std::endl;
         }
     }
+    
+    // 扩展函数与深层嵌套测试
+    std::cout << "\n扩展函数测试：" << std::endl;
+    FunctionRegistry::instance().add("exp", [](double arg, double& result) {
+        result = exp(arg);
+        return EVAL_OK;
+    });
+    std::string nested = "1";
+    for (int depth = 0; depth < 10000; depth++) {
+        nested = "abs(-" + nested + ")";
+    }
+    std::vector<std::string> extensionTests = {
+        "exp(1)",                  // e ≈ 2.718282
+        "ln(exp(2))",              // 2
+        "sqrt(abs(sin(-30)*-32))", // 4
+        "2.5!",                    // Γ(3.5) ≈ 3.323351
+        "170!/10^300",             // 查表 ≈ 7257415.615308
+        "(-3)!",                   // 负整数无定义
+        "sin(390)+cos(-420)",      // 特殊角精确值 1
+        "sin(1)*1000000",          // 全精度结果 17452.406437（旧实现截断为 17452）
+        "log(-1)",                 // 定义域错误
+        nested,                    // 10000 层嵌套
+    };
+    
+    for (const auto& test : extensionTests) {
+        std::string label = test.size() > 40 ? "abs(-abs(-...)) [10000 层]" : test;
+        try {
+            double result = evaluateExtendedExpression(test);
+            std::cout << label << " = " << std::fixed << std::setprecision(6) << result << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << label << " -> 错误: " << e.what() << std::endl;
+        }
+    }
+    
+    // 编译执行测试：编译一次，绑定不同变量值多次求值
+    std::cout << "\n编译执行测试：" << std::endl;
+    for (const auto& test : testCases) {
+        double expected = evaluateBasicExpression(test);
+        double result;
+        EvalStatus status = evaluate(compileExpression(test), nullptr, result);
+        std::cout << test << " -> " << (status == EVAL_OK && result == expected ? "一致" : "不一致")
+                  << std::endl;
+    }
+    
+    Program program = compileExpression("x^2+2*x*y-sqrt(y)/-x", {"x", "y"});
+    for (double x = 1; x <= 3; x++) {
+        double bindings[] = {x, 4};
+        double result;
+        evaluate(program, bindings, result);
+        std::cout << "x^2+2*x*y-sqrt(y)/-x [x=" << (int)x << ", y=4] = "
+                  << std::fixed << std::setprecision(6) << result << std::endl;
+    }
+    
+    std::vector<std::string> programErrors = {"1/(x-1)", "-x!", "ln(x-1)"};
+    for (const auto& test : programErrors) {
+        double bindings[] = {1};
+        double result;
+        EvalStatus status = evaluate(compileExpression(test, {"x"}), bindings, result);
+        std::cout << test << " [x=1] -> 状态: " << evalMessage[status] << std::endl;
+    }
+    
+    // 批量求值测试：与逐行 evaluate 的结果和状态比较
+    std::cout << "\n批量求值测试（" << BATCH_SIMD_NAME << "）：" << std::endl;
+    const size_t rows = 1000;
+    std::vector<double> xs(rows), ys(rows), out(rows);
+    std::vector<unsigned char> status(rows);
+    for (size_t r = 0; r < rows; r++) {
+        xs[r] = (double)r / 10 - 20;
+        ys[r] = r % 2 ? (double)(r % 7) : (double)(r % 7) - 3.5; // 整数与非整数（含负数）交替
+    }
+    Program batchProgram = compileExpression("x/(y-3)+sqrt(x)*2-abs(y)^2", {"x", "y"});
+    const double* columns[] = {xs.data(), ys.data()};
+    evaluateBatch(batchProgram, columns, rows, out.data(), status.data());
+    
+    size_t mismatches = 0, errorRows = 0;
+    for (size_t r = 0; r < rows; r++) {
+        double bindings[] = {xs[r], ys[r]};
+        double expected = 0;
+        EvalStatus expectedStatus = evaluate(batchProgram, bindings, expected);
+        if (expectedStatus != status[r] || (expectedStatus == EVAL_OK && expected != out[r])) {
+            mismatches++;
+        }
+        if (status[r] != EVAL_OK) {
+            errorRows++;
+        }
+    }
+    std::cout << "x/(y-3)+sqrt(x)*2-abs(y)^2 共 " << rows << " 行，出错行 " << errorRows
+              << "，与逐行求值不一致 " << mismatches << " 行" << std::endl;
+    
+    // 内存分配测试：复用求值上下文时，深度不超过内联容量的表达式不分配堆内存。
+    // 默认统计求值上下文中各栈的扩容次数（每次扩容分配一次堆内存）；
+    // 加 -DCALC_COUNT_ALLOCS 编译时改为统计进程内的全部堆分配
+    std::cout << "\n内存分配测试：" << std::endl;
+    EvalContext context;
+    auto allocations = [&] {
+#ifdef CALC_COUNT_ALLOCS
+        return heapAllocations.load();
+#else
+        return context.allocations();
+#endif
+    };
+    std::string deep = "1";
+    for (int depth = 0; depth < 40; depth++) {
+        deep = "1+(" + deep + ")";
+    }
+    double bindings[] = {2, 4};
+    double result;
+    size_t before = allocations();
+    for (int k = 0; k < 1000; k++) {
+        evaluate(program, bindings, result, context);
+        evaluateBasicExpression("((2+3)*4-5)/2+2^3*5!", context);
+    }
+    size_t shallow = allocations() - before;
+    std::cout << "2000 次浅层求值的堆分配次数: " << shallow << "，结果" << (shallow == 0 ? "一致" : "不一致")
+              << std::endl;
+    
+    before = allocations();
+    evaluateBasicExpression(deep, context);
+    size_t firstDeep = allocations() - before;
+    before = allocations();
+    for (int k = 0; k < 1000; k++) {
+        evaluateBasicExpression(deep, context);
+    }
+    size_t reused = allocations() - before;
+    std::cout << "深度 41 的表达式首次求值堆分配 " << firstDeep << " 次，复用上下文后 1000 次求值分配 "
+              << reused << " 次，结果" << (firstDeep > 0 && reused == 0 ? "一致" : "不一致") << std::endl;
+    
+    // 编译缓存测试：空白不同的相同表达式共享缓存条目
+    std::cout << "\n编译缓存测试：" << std::endl;
+    ExpressionCache cache(4096);
+    std::vector<std::string> cacheTests = {"2 * sqrt(16)", "2*sqrt(16)", " 2*sqrt( 16 ) ",
+                                           "x^2+1", "x ^ 2 + 1", "1/0",
+                                           "12", "1 2",           // 空白分隔的两个数字不能合并
+                                           "2 3+1", "1 .5", "s in(30)",
+                                           "1 + 1.2.3", "  1 +  1.2.3"}; // 出错位置对应原文
+    for (const auto& test : cacheTests) {
+        std::cout << "\"" << test << "\" -> ";
+        std::shared_ptr<const ExpressionCache::Entry> entry;
+        try {
+            entry = cache.lookup(test);
+        } catch (const std::exception& e) {
+            std::cout << "错误: " << e.what() << std::endl;
+            continue;
+        }
+        if (!entry->constant()) {
+            std::cout << "程序（" << entry->program->code.size() << " 条指令）" << std::endl;
+        } else if (entry->status != EVAL_OK) {
+            std::cout << "错误: " << evalMessage[entry->status] << std::endl;
+        } else {
+            std::cout << "常量 " << entry->value << std::endl;
+        }
+    }
+    for (int k = 0; k < 100; k++) {
+        cache.lookup(std::to_string(k) + "+x");
+    }
+    ExpressionCache::Stats stats = cache.stats();
+    std::cout << "命中 " << stats.hits << "，未命中 " << stats.misses << "，淘汰 " << stats.evictions
+              << "，条目 " << stats.entries << "，占用 " << stats.bytes << " 字节（预算 4096）" << std::endl;
+    
+    // 表达式优化测试（比较运算指令条数，取数与临时值存取不计）
+    std::cout << "\n表达式优化测试：" << std::endl;
+    auto operations = [](const Program& program) {
+        return std::count_if(program.code.begin(), program.code.end(), [](const Instruction& ins) {
+            return ins.code <= I_FAC || ins.code == I_NEG || ins.code == I_FUNC;
+        });
+    };
+    std::vector<std::string> optimizeTests = {"sqrt(16)*2*x", "5!*y", "sin(x)*sin(x)+cos(x)*cos(x)",
+                                              "(x+y)^2", "1/0+x", "1+sin(x)*sin(x)", "2+(x+1)*(x+1)*y",
+                                              "3*(x*y)+(x*y)"};
+    for (const auto& test : optimizeTests) {
+        Program original = compileExpression(test, {"x", "y"});
+        Program optimized = optimizeProgram(original);
+        Program twice = optimizeProgram(optimized); // 含临时槽位的程序再优化一次
+        double values[] = {30, 2};
+        double before = 0, after = 0, again = 0;
+        EvalStatus statusBefore = evaluate(original, values, before);
+        EvalStatus statusAfter = evaluate(optimized, values, after);
+        EvalStatus statusAgain = evaluate(twice, values, again);
+        bool same = statusBefore == statusAfter && before == after && statusBefore == statusAgain && before == again;
+        std::cout << test << ": 运算 " << operations(original) << " -> " << operations(optimized)
+                  << " 次，" << (same ? "结果一致" : "结果不一致") << std::endl;
+    }
+    
+    // 差分测试：随机表达式经优化（及再次优化）后，与 evaluateBasicExpression / 未优化程序的结果和错误一致，
+    // 闭包树引擎与字节码解释器的结果和错误一致
+    std::mt19937 gen(20240601);
+    int differential = 0, differences = 0;
+    auto same = [](EvalStatus s1, double r1, EvalStatus s2, double r2) {
+        return s1 == s2 && (s1 != EVAL_OK || r1 == r2 || (std::isnan(r1) && std::isnan(r2)));
+    };
+    for (int k = 0; k < 3000; k++, differential++) {
+        std::string expr = randomExpression(gen, 5, false);
+        double expected = 0, actual = 0;
+        std::string expectedError;
+        try {
+            expected = evaluateBasicExpression(expr);
+        } catch (const std::exception& e) {
+            expectedError = e.what();
+        }
+        EvalStatus status = evaluate(optimizeProgram(compileExpression(expr)), nullptr, actual);
+        bool ok = expectedError.empty() ? same(EVAL_OK, expected, status, actual)
+                                        : status != EVAL_OK && expectedError == evalMessage[status];
+        if (!ok) {
+            differences++;
+        }
+    }
+    for (int k = 0; k < 3000; k++, differential++) {
+        std::string expr = randomExpression(gen, 5, true);
+        Program original = compileExpression(expr, {"x"});
+        Program optimized = optimizeProgram(original);
+        Program reoptimized = optimizeProgram(optimized); // 再优化含临时槽位的程序，结果不变
+        ClosureProgram closure = compileClosure(optimized);
+        for (double x : {-2.5, 0.0, 3.0, 45.0}) {
+            double before = 0, after = 0, again = 0, tree = 0;
+            EvalStatus statusBefore = evaluate(original, &x, before);
+            EvalStatus statusAfter = evaluate(optimized, &x, after);
+            EvalStatus statusAgain = evaluate(reoptimized, &x, again);
+            EvalStatus statusTree = evaluate(closure, &x, tree);
+            if (!same(statusBefore, before, statusAfter, after) ||
+                !same(statusBefore, before, statusAgain, again) ||
+                !same(statusBefore, before, statusTree, tree)) {
+                differences++;
+                break;
+            }
+        }
+    }
+    std::cout << "差分测试：" << differential << " 个随机表达式，不一致 " << differences << " 个" << std::endl;
+    
+    // 公式表测试：输入变化只重算受影响的公式
+    std::cout << "\n公式表测试：" << std::endl;
+    FormulaSheet sheet;
+    sheet.define("area = w*h");
+    sheet.define("cost = area*price+fee");
+    sheet.define("total = cost*(1+tax)");
+    sheet.update({{"w", 3}, {"h", 4}, {"price", 2.5}, {"fee", 10}, {"tax", 0.1}});
+    std::cout << "total = " << sheet.value("total") << "（重算 " << sheet.lastRecomputed() << " 个公式）" << std::endl;
+    sheet.set("tax", 0.2);
+    std::cout << "修改 tax 后 total = " << sheet.value("total") << "（重算 " << sheet.lastRecomputed()
+              << " 个公式）" << std::endl;
+    sheet.update({{"w", 4}, {"h", 3}});
+    std::cout << "交换 w、h 后 total = " << sheet.value("total") << "（重算 " << sheet.lastRecomputed()
+              << " 个公式，area 未变，不再向下传播）" << std::endl;
+    try {
+        sheet.define("fee = total/100");
+    } catch (const std::exception& e) {
+        std::cout << "fee = total/100 -> 错误: " << e.what() << std::endl;
+    }
+    sheet.define("ratio = fee/(w-4)");
+    std::cout << "ratio -> 状态: " << evalMessage[sheet.status("ratio")] << std::endl;
+    double totalBefore = sheet.value("total");
+    try {
+        sheet.update({{"w", 10}, {"area", 1}});
+    } catch (const std::exception& e) {
+        std::cout << "同时修改 w 与 area -> 错误: " << e.what() << std::endl;
+    }
+    sheet.set("h", 3); // 不改变值，只触发一次传播，检查上一批没有残留的排队
+    std::cout << "失败的批量更新整体不生效: "
+              << (sheet.value("w") == 4 && sheet.value("total") == totalBefore && sheet.lastRecomputed() == 0
+                  ? "一致" : "不一致") << std::endl;
+    
+    for (int k = 0; k < 1000; k++) {
+        sheet.define("f" + std::to_string(k) + " = sqrt(abs(in" + std::to_string(k % 10) + ")) + " +
+                     (k >= 10 ? "f" + std::to_string(k - 10) : std::string("0")));
+    }
+    sheet.set("in3", 16);
+    std::cout << "1000 个公式中修改 in3 后重算 " << sheet.lastRecomputed() << " 个，f993 = "
+              << sheet.value("f993") << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        return runBatchMode(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmarks();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--server") {
+        return runServerMode(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--loadgen") {
+        return runLoadGenerator(argc, argv);
+    }
+    
     runTests();
     
     // 交互式测试
@@ -492,6 +3726,14 @@ int main() {
         if (input == "quit" || input == "exit") {
             break;
         }
+        if (input == "profile") {
+#ifdef CALC_PROFILE
+            std::cout << Profiler::instance().json();
+#else
+            std::cout << "未启用性能剖析（编译时加 -DCALC_PROFILE）" << std::endl;
+#endif
+            continue;
+        }
         
         try {
             double result = evaluateExtendedExpression(input);
@@ -1,3 +1,6 @@
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64 //32 位平台上 off_t 也取 64 位，列式文件可超过 2GB
+#endif
 #include <iostream>
 #include <vector>
 #include <algorithm>
@@ -5,6 +8,46 @@
 #include <ctime>
 #include <cmath>
 #include <iomanip>
+#include <string>
+#include <cstdint>
+#include <new>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#ifdef __unix__
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#define COMPLEX_EPSILON 1e-9 //复数比较的容差
+
+// 操作计数（编译时加 -DCOMPLEX_COUNT_OPS 启用）：统计元素比较与复制次数，供基准测试报告。
+// 启用后 Complex 带有自定义的复制操作，不再是平凡可复制类型，计时中也包含计数的开销
+#ifdef COMPLEX_COUNT_OPS
+std::atomic<uint64_t> complexComparisons(0);
+std::atomic<uint64_t> complexMoves(0);
+#define COUNT_COMPARISON() complexComparisons.fetch_add(1, std::memory_order_relaxed)
+#define COUNT_MOVE() complexMoves.fetch_add(1, std::memory_order_relaxed)
+#else
+#define COUNT_COMPARISON() ((void)0)
+#define COUNT_MOVE() ((void)0)
+#endif
 
 class Complex {
 private:
@@ -15,6 +58,19 @@ public:
     // 构造函数
     Complex(double real = 0.0, double imag = 0.0) : real_part(real), imag_part(imag) {}
     
+#ifdef COMPLEX_COUNT_OPS
+    Complex(const Complex& other) : real_part(other.real_part), imag_part(other.imag_part) {
+        COUNT_MOVE();
+    }
+    
+    Complex& operator=(const Complex& other) {
+        real_part = other.real_part;
+        imag_part = other.imag_part;
+        COUNT_MOVE();
+        return *this;
+    }
+#endif
+    
     // 获取实部
     double getReal() const {
         return real_part;
@@ -32,18 +88,18 @@ public:
     
     // 重载 == 操作符
     bool operator==(const Complex& other) const {
-        const double epsilon = 1e-9;
-        return (abs(real_part - other.real_part) < epsilon) && 
-               (abs(imag_part - other.imag_part) < epsilon);
+        COUNT_COMPARISON();
+        return (std::fabs(real_part - other.real_part) < COMPLEX_EPSILON) && 
+               (std::fabs(imag_part - other.imag_part) < COMPLEX_EPSILON);
     }
     
     // 重载 < 操作符，用于排序（首先按模排序，模相同时按实部排序）
     bool operator<(const Complex& other) const {
-        const double epsilon = 1e-9;
+        COUNT_COMPARISON();
         double this_mag = this->magnitude();
         double other_mag = other.magnitude();
         
-        if (abs(this_mag - other_mag) < epsilon) {
+        if (std::fabs(this_mag - other_mag) < COMPLEX_EPSILON) {
             // 模相同时按实部排序
             return real_part < other.real_part;
         } else {
@@ -155,10 +211,10 @@ void merge(std::vector<Complex>& vec, int left, int mid, int right) {
     for (int j = 0; j < n2; j++)
         rightVec[j] = vec[mid + 1 + j];
 
-    // 合并临时向量
+    // 合并临时向量（相等时取左侧元素，保证排序稳定）
     int i = 0, j = 0, k = left;
     while (i < n1 && j < n2) {
-        if (leftVec[i] < rightVec[j]) {
+        if (!(rightVec[j] < leftVec[i])) {
             vec[k] = leftVec[i];
             i++;
         } else {
@@ -193,145 +249,3962 @@ void mergeSort(std::vector<Complex>& vec, int left, int right) {
     }
 }
 
-// 区间查找算法，找出模介于[m1, m2)的所有元素
-std::vector<Complex> rangeSearch(const std::vector<Complex>& vec, double m1, double m2) {
-    std::vector<Complex> result;
-    for (const Complex& c : vec) {
-        double mag = c.magnitude();
-        if (mag >= m1 && mag < m2) {
-            result.push_back(c);
+// ===================== 预计算排序键的排序 =====================
+
+// 按 Complex::operator< 的规则比较已算好的模和实部
+inline bool magnitudeLess(double magA, double realA, double magB, double realB) {
+    COUNT_COMPARISON();
+    if (std::fabs(magA - magB) < COMPLEX_EPSILON) {
+        return realA < realB;
+    }
+    return magA < magB;
+}
+
+// 带排序键的复数：模只在建键时计算一次，之后的比较不再开方
+struct KeyedComplex {
+    double mag;
+    Complex value;
+    
+    bool operator<(const KeyedComplex& other) const {
+        return magnitudeLess(mag, value.getReal(), other.mag, other.value.getReal());
+    }
+};
+
+// 为每个元素计算排序键
+std::vector<KeyedComplex> makeKeys(const std::vector<Complex>& vec) {
+    std::vector<KeyedComplex> keyed(vec.size());
+    for (size_t i = 0; i < vec.size(); i++) {
+        keyed[i] = {vec[i].magnitude(), vec[i]};
+    }
+    return keyed;
+}
+
+// 去掉排序键，写回原向量
+void storeKeys(const std::vector<KeyedComplex>& keyed, std::vector<Complex>& vec) {
+    for (size_t i = 0; i < keyed.size(); i++) {
+        vec[i] = keyed[i].value;
+    }
+}
+
+// 与 std::sort(vec.begin(), vec.end()) 结果相同：逐次比较的结果一致，排序过程也一致
+void sortKeyed(std::vector<Complex>& vec) {
+    std::vector<KeyedComplex> keyed = makeKeys(vec);
+    std::sort(keyed.begin(), keyed.end());
+    storeKeys(keyed, vec);
+}
+
+// 起泡排序（预计算键），与 bubbleSort 结果相同
+void bubbleSortKeyed(std::vector<Complex>& vec) {
+    std::vector<KeyedComplex> keyed = makeKeys(vec);
+    int n = keyed.size();
+    for (int i = 0; i < n - 1; ++i) {
+        for (int j = 0; j < n - i - 1; ++j) {
+            if (keyed[j + 1] < keyed[j]) {
+                std::swap(keyed[j], keyed[j + 1]);
+            }
         }
     }
-    // 按照排序规则排序结果
-    std::sort(result.begin(), result.end());
-    return result;
+    storeKeys(keyed, vec);
 }
 
-// 打印向量
-void printVector(const std::vector<Complex>& vec, const std::string& title) {
-    std::cout << title << ": ";
-    for (const Complex& c : vec) {
-        std::cout << c << " ";
+// 归并 [left, mid] 与 [mid + 1, right]，取舍规则与 merge 相同；buffer 由调用方提供
+void mergeKeyed(std::vector<KeyedComplex>& keyed, std::vector<KeyedComplex>& buffer,
+                int left, int mid, int right) {
+    std::copy(keyed.begin() + left, keyed.begin() + right + 1, buffer.begin() + left);
+    int i = left, j = mid + 1, k = left;
+    while (i <= mid && j <= right) {
+        if (!(buffer[j] < buffer[i])) {
+            keyed[k++] = buffer[i++];
+        } else {
+            keyed[k++] = buffer[j++];
+        }
+    }
+    while (i <= mid) {
+        keyed[k++] = buffer[i++];
+    }
+    while (j <= right) {
+        keyed[k++] = buffer[j++];
     }
-    std::cout << std::endl;
 }
 
-int main() {
-    std::cout << "=== 复数向量操作测试 ===" << std::endl;
+void mergeSortKeyed(std::vector<KeyedComplex>& keyed, std::vector<KeyedComplex>& buffer, int left, int right) {
+    if (left < right) {
+        int mid = left + (right - left) / 2;
+        mergeSortKeyed(keyed, buffer, left, mid);
+        mergeSortKeyed(keyed, buffer, mid + 1, right);
+        mergeKeyed(keyed, buffer, left, mid, right);
+    }
+}
+
+// 归并排序（预计算键），与 mergeSort(vec, 0, vec.size() - 1) 结果相同
+void mergeSortKeyed(std::vector<Complex>& vec) {
+    std::vector<KeyedComplex> keyed = makeKeys(vec);
+    std::vector<KeyedComplex> buffer(keyed.size());
+    mergeSortKeyed(keyed, buffer, 0, (int)keyed.size() - 1);
+    storeKeys(keyed, vec);
+}
+
+// ===================== 并行归并排序 =====================
+
+#define PARALLEL_SORT_CUTOFF (1 << 14) //子区间不超过该长度时顺序排序
+#define PARALLEL_MERGE_GRAIN (1 << 15) //并行归并时每个任务输出的最少元素数
+
+// 工作窃取线程池：每个工作线程有自己的任务双端队列，从队尾取自己的任务（后进先出，
+// 数据仍在缓存中），空闲时从其他线程的队头窃取（先进先出，窃得的通常是较大的任务）
+class WorkStealingPool {
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
     
-    // (1) 测试无序向量的置乱、查找、插入、删除和唯一化操作
-    std::cout << "\n(1) 测试无序向量的置乱、查找、插入、删除和唯一化操作:" << std::endl;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> nextQueue{0};
+    std::mutex idleMutex;
+    std::condition_variable idle;
     
-    // 生成随机复数向量
-    std::vector<Complex> vec = generateRandomComplexVector(10);
-    printVector(vec, "原始向量");
+    // 当前线程在哪个线程池中的编号（外部线程为 -1）
+    static thread_local WorkStealingPool* currentPool;
+    static thread_local int currentIndex;
     
-    // 测试置乱
-    shuffleVector(vec);
-    printVector(vec, "置乱后向量");
+    bool popLocal(int index, std::function<void()>& task) {
+        Worker& w = *workers[index];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (w.tasks.empty()) {
+            return false;
+        }
+        task = std::move(w.tasks.back());
+        w.tasks.pop_back();
+        return true;
+    }
     
-    // 测试查找
-    Complex target(1.5, 2.5);
-    int index = findComplex(vec, target);
-    std::cout << "查找 " << target << " 的位置: " << index << std::endl;
+    bool steal(int thief, std::function<void()>& task) {
+        size_t n = workers.size();
+        size_t start = thief >= 0 ? thief + 1 : nextQueue.fetch_add(1, std::memory_order_relaxed);
+        for (size_t k = 0; k < n; k++) {
+            Worker& w = *workers[(start + k) % n];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (!w.tasks.empty()) {
+                task = std::move(w.tasks.front());
+                w.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
     
-    // 测试插入
-    Complex newComplex(3.0, 4.0);
-    insertComplex(vec, 2, newComplex);
-    printVector(vec, "在位置2插入 " + std::string("3.00+4.00i") + " 后");
+    void workerLoop(int index) {
+        currentPool = this;
+        currentIndex = index;
+        while (!stopping) {
+            if (!runOne()) {
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idle.wait_for(lock, std::chrono::milliseconds(1), [&] { return queued > 0 || stopping; });
+            }
+        }
+    }
     
-    // 测试删除
-    removeComplex(vec, 0);  // 删除位置0的元素
-    printVector(vec, "删除位置0的元素后");
+public:
+    explicit WorkStealingPool(unsigned threadCount) {
+        threadCount = std::max(1u, threadCount);
+        for (unsigned t = 0; t < threadCount; t++) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (unsigned t = 0; t < threadCount; t++) {
+            threads.emplace_back(&WorkStealingPool::workerLoop, this, (int)t);
+        }
+    }
     
-    // 测试唯一化
-    std::vector<Complex> vecWithDups = generateRandomComplexVector(12);
-    printVector(vecWithDups, "含重复元素的向量");
-    uniqueVector(vecWithDups);
-    printVector(vecWithDups, "唯一化后的向量");
+    ~WorkStealingPool() {
+        stopping = true;
+        idle.notify_all();
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
     
-    // (2) 测试排序和效率比较
-    std::cout << "\n(2) 测试排序和效率比较:" << std::endl;
+    size_t size() const {
+        return workers.size();
+    }
     
-    // 准备不同顺序的向量
-    std::vector<Complex> originalVec = generateRandomComplexVector(1000);
+    // 提交任务：工作线程放入自己的队列，外部线程轮流放入各队列
+    void submit(std::function<void()> task) {
+        int index = currentPool == this ? currentIndex
+                                        : (int)(nextQueue.fetch_add(1, std::memory_order_relaxed) % workers.size());
+        queued++;
+        {
+            std::lock_guard<std::mutex> lock(workers[index]->mutex);
+            workers[index]->tasks.push_back(std::move(task));
+        }
+        idle.notify_one();
+    }
     
-    // 顺序向量
-    std::vector<Complex> orderedVec = originalVec;
-    std::sort(orderedVec.begin(), orderedVec.end());
+    // 执行一个任务（优先自己的队列，其次窃取），没有任务时返回 false
+    bool runOne() {
+        std::function<void()> task;
+        int index = currentPool == this ? currentIndex : -1;
+        if ((index >= 0 && popLocal(index, task)) || steal(index, task)) {
+            queued--;
+            task();
+            return true;
+        }
+        return false;
+    }
+};
+
+thread_local WorkStealingPool* WorkStealingPool::currentPool = nullptr;
+thread_local int WorkStealingPool::currentIndex = -1;
+
+// 一组分叉出去的任务；wait 时当前线程也参与执行任务，嵌套分叉不会死锁
+class TaskGroup {
+private:
+    WorkStealingPool& pool;
+    std::atomic<int> pending{0};
     
-    // 逆序向量
-    std::vector<Complex> reverseVec = orderedVec;
-    std::reverse(reverseVec.begin(), reverseVec.end());
+public:
+    explicit TaskGroup(WorkStealingPool& p) : pool(p) {}
     
-    // 随机向量
-    std::vector<Complex> randomVec = originalVec;
+    ~TaskGroup() {
+        wait();
+    }
     
-    // 测试起泡排序
-    std::vector<Complex> testVec;
+    template<typename F>
+    void run(F f) {
+        pending++;
+        pool.submit([this, f] {
+            f();
+            pending--;
+        });
+    }
     
-    // 测试顺序向量的起泡排序
-    testVec = orderedVec;
-    clock_t start = clock();
-    bubbleSort(testVec);
-    clock_t end = clock();
-    double bubbleOrderedTime = double(end - start) / CLOCKS_PER_SEC;
-    std::cout << "顺序向量起泡排序时间: " << std::fixed << std::setprecision(6) << bubbleOrderedTime << "s" << std::endl;
+    void wait() {
+        while (pending > 0) {
+            if (!pool.runOne()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+};
+
+// 把 [0, n) 分成若干块并行执行 body(begin, end)
+template<typename Body>
+void parallelFor(WorkStealingPool& pool, size_t n, size_t grain, Body body) {
+    size_t chunks = std::max<size_t>(1, std::min(n / std::max<size_t>(1, grain), pool.size() * 4));
+    TaskGroup group(pool);
+    for (size_t c = 0; c < chunks; c++) {
+        size_t begin = n * c / chunks;
+        size_t end = n * (c + 1) / chunks;
+        group.run([=] { body(begin, end); });
+    }
+}
+
+// 协同秩：A、B 稳定归并（相等时 A 在前）后的前 k 个元素中有多少个来自 A
+size_t coRank(size_t k, const KeyedComplex* a, size_t na, const KeyedComplex* b, size_t nb) {
+    size_t lo = k > nb ? k - nb : 0;
+    size_t hi = std::min(k, na);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = k - i;
+        if (b[j - 1] < a[i]) {
+            hi = i;
+        } else {
+            lo = i + 1;
+        }
+    }
+    return lo;
+}
+
+// 并行归并 [left, mid] 与 [mid + 1, right]：先把两段复制到 buffer，
+// 再把输出切成若干块，每块按协同秩找到对应的输入位置后独立归并
+void parallelMergeKeyed(WorkStealingPool& pool, std::vector<KeyedComplex>& keyed,
+                        std::vector<KeyedComplex>& buffer, int left, int mid, int right) {
+    size_t n = right - left + 1;
+    parallelFor(pool, n, PARALLEL_MERGE_GRAIN, [&](size_t begin, size_t end) {
+        std::copy(keyed.begin() + left + begin, keyed.begin() + left + end, buffer.begin() + left + begin);
+    });
     
-    // 测试逆序向量的起泡排序
-    testVec = reverseVec;
-    start = clock();
-    bubbleSort(testVec);
-    end = clock();
-    double bubbleReverseTime = double(end - start) / CLOCKS_PER_SEC;
-    std::cout << "逆序向量起泡排序时间: " << std::fixed << std::setprecision(6) << bubbleReverseTime << "s" << std::endl;
+    const KeyedComplex* a = buffer.data() + left;
+    const KeyedComplex* b = buffer.data() + mid + 1;
+    size_t na = mid - left + 1;
+    size_t nb = right - mid;
+    parallelFor(pool, n, PARALLEL_MERGE_GRAIN, [&, a, b, na, nb](size_t begin, size_t end) {
+        size_t i = coRank(begin, a, na, b, nb);
+        size_t j = begin - i;
+        size_t iEnd = coRank(end, a, na, b, nb);
+        size_t jEnd = end - iEnd;
+        KeyedComplex* out = keyed.data() + left + begin;
+        while (i < iEnd && j < jEnd) {
+            if (!(b[j] < a[i])) {
+                *out++ = a[i++];
+            } else {
+                *out++ = b[j++];
+            }
+        }
+        out = std::copy(a + i, a + iEnd, out);
+        std::copy(b + j, b + jEnd, out);
+    });
+}
+
+// 分治：左半部分分叉到线程池，右半部分由当前线程继续；切分点与 mergeSort 相同
+void parallelMergeSortKeyed(WorkStealingPool& pool, std::vector<KeyedComplex>& keyed,
+                            std::vector<KeyedComplex>& buffer, int left, int right, int cutoff) {
+    if (right - left + 1 <= cutoff) {
+        mergeSortKeyed(keyed, buffer, left, right);
+        return;
+    }
+    int mid = left + (right - left) / 2;
+    {
+        TaskGroup group(pool);
+        group.run([&, left, mid] { parallelMergeSortKeyed(pool, keyed, buffer, left, mid, cutoff); });
+        parallelMergeSortKeyed(pool, keyed, buffer, mid + 1, right, cutoff);
+    }
+    parallelMergeKeyed(pool, keyed, buffer, left, mid, right);
+}
+
+// 并行归并排序：结果与 mergeSort(vec, 0, vec.size() - 1) 相同（稳定）
+void parallelMergeSort(std::vector<Complex>& vec, WorkStealingPool& pool, int cutoff = PARALLEL_SORT_CUTOFF) {
+    std::vector<KeyedComplex> keyed(vec.size());
+    std::vector<KeyedComplex> buffer(vec.size());
+    parallelFor(pool, vec.size(), PARALLEL_MERGE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            keyed[i] = {vec[i].magnitude(), vec[i]};
+        }
+    });
+    parallelMergeSortKeyed(pool, keyed, buffer, 0, (int)vec.size() - 1, std::max(cutoff, 2));
+    parallelFor(pool, vec.size(), PARALLEL_MERGE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            vec[i] = keyed[i].value;
+        }
+    });
+}
+
+// ===================== 自适应归并排序 =====================
+
+#define ADAPTIVE_MIN_GALLOP 7 //连续取自同一侧多少次后进入飞奔模式
+
+// 自适应归并排序（TimSort 式）：识别已有的升序段和严格降序段（降序段原地翻转），
+// 短段用二分插入补足到 minRun，再按栈规则归并相邻段，归并中一侧连续胜出时改为指数查找整段搬移。
+// 已排序或逆序的输入只需 O(n) 次比较；排序结果稳定，与 mergeSort 相同。
+// 键数组、归并缓冲与段栈在对象中复用，容量足够后再次排序不分配内存
+class AdaptiveMergeSorter {
+private:
+    typedef KeyedComplex T;
     
-    // 测试随机向量的起泡排序
-    testVec = randomVec;
-    start = clock();
-    bubbleSort(testVec);
-    end = clock();
-    double bubbleRandomTime = double(end - start) / CLOCKS_PER_SEC;
-    std::cout << "随机向量起泡排序时间: " << std::fixed << std::setprecision(6) << bubbleRandomTime << "s" << std::endl;
+    struct Run {
+        size_t start;
+        size_t length;
+    };
     
-    // 测试归并排序
-    // 测试顺序向量的归并排序
-    testVec = orderedVec;
-    start = clock();
-    mergeSort(testVec, 0, testVec.size() - 1);
-    end = clock();
-    double mergeOrderedTime = double(end - start) / CLOCKS_PER_SEC;
-    std::cout << "顺序向量归并排序时间: " << std::fixed << std::setprecision(6) << mergeOrderedTime << "s" << std::endl;
+    std::vector<T> keyed;
+    std::vector<T> buffer; // 归并时暂存较短的一段，容量为 n / 2 + 1
+    std::vector<Run> runs;
+    size_t minGallop = ADAPTIVE_MIN_GALLOP;
     
-    // 测试逆序向量的归并排序
-    testVec = reverseVec;
-    start = clock();
-    mergeSort(testVec, 0, testVec.size() - 1);
-    end = clock();
-    double mergeReverseTime = double(end - start) / CLOCKS_PER_SEC;
-    std::cout << "逆序向量归并排序时间: " << std::fixed << std::setprecision(6) << mergeReverseTime << "s" << std::endl;
+    // 前缀中 before 为真的元素个数（before 在区间上先真后假），从左端指数查找再二分
+    template<typename Before>
+    static size_t gallopForward(const T* base, size_t len, Before before) {
+        size_t lo = 0, hi = 0, step = 1;
+        while (hi < len && before(base[hi])) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        hi = std::min(hi, len);
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (before(base[mid])) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
     
-    // 测试随机向量的归并排序
-    testVec = randomVec;
-    start = clock();
-    mergeSort(testVec, 0, testVec.size() - 1);
-    end = clock();
-    double mergeRandomTime = double(end - start) / CLOCKS_PER_SEC;
-    std::cout << "随机向量归并排序时间: " << std::fixed << std::setprecision(6) << mergeRandomTime << "s" << std::endl;
+    // 后缀中 after 为真的元素个数（after 在区间上先假后真），从右端指数查找再二分
+    template<typename After>
+    static size_t gallopBackward(const T* base, size_t len, After after) {
+        size_t lo = 0, hi = 0, step = 1;
+        while (hi < len && after(base[len - 1 - hi])) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        hi = std::min(hi, len);
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (after(base[len - 1 - mid])) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
     
-    // (3) 测试区间查找算法
-    std::cout << "\n(3) 测试区间查找算法:" << std::endl;
+    // minRun：使段数接近 2 的幂，归并更均衡
+    static size_t minRunLength(size_t n) {
+        size_t r = 0;
+        while (n >= 64) {
+            r |= n & 1;
+            n >>= 1;
+        }
+        return n + r;
+    }
     
-    std::vector<Complex> searchVec = generateRandomComplexVector(20);
-    printVector(searchVec, "用于区间查找的向量");
+    // 从 lo 开始的自然段长度；严格降序段翻转为升序（严格才能保证稳定）
+    size_t countRun(size_t lo, size_t n) {
+        T* data = keyed.data();
+        size_t end = lo + 1;
+        if (end == n) {
+            return 1;
+        }
+        if (data[end] < data[lo]) {
+            while (end < n && data[end] < data[end - 1]) {
+                end++;
+            }
+            std::reverse(data + lo, data + end);
+        } else {
+            while (end < n && !(data[end] < data[end - 1])) {
+                end++;
+            }
+        }
+        return end - lo;
+    }
     
-    // 对向量进行排序，以便测试区间查找
-    std::sort(searchVec.begin(), searchVec.end());
-    printVector(searchVec, "排序后的向量");
+    // 二分插入排序：[lo, lo + sorted) 已有序，把其余元素插入到相等元素之后
+    void binaryInsertionSort(size_t lo, size_t sorted, size_t length) {
+        T* data = keyed.data() + lo;
+        for (size_t k = sorted; k < length; k++) {
+            T pivot = data[k];
+            size_t pos = gallopForward(data, k, [&](const T& x) { return !(pivot < x); });
+            std::copy_backward(data + pos, data + k, data + k + 1);
+            data[pos] = pivot;
+        }
+    }
     
-    double m1 = 2.0, m2 = 5.0;
-    std::vector<Complex> rangeResult = rangeSearch(searchVec, m1, m2);
-    printVector(rangeResult, "模在[" + std::to_string(m1) + "," + std::to_string(m2) + ")之间的元素");
+    // 较短的左段放入缓冲，从前向后归并
+    void mergeLo(T* a, size_t na, T* b, size_t nb) {
+        T* tmp = buffer.data();
+        std::copy(a, a + na, tmp);
+        T* out = a;
+        size_t i = 0, j = 0;
+        while (i < na && j < nb) {
+            // 逐个比较，记录同一侧连续胜出的次数
+            size_t winsA = 0, winsB = 0;
+            while (i < na && j < nb && winsA < minGallop && winsB < minGallop) {
+                if (b[j] < tmp[i]) {
+                    *out++ = b[j++];
+                    winsB++;
+                    winsA = 0;
+                } else {
+                    *out++ = tmp[i++];
+                    winsA++;
+                    winsB = 0;
+                }
+            }
+            // 飞奔：整段搬移不大于对方当前元素的前缀
+            while (i < na && j < nb) {
+                size_t ka = gallopForward(tmp + i, na - i, [&](const T& x) { return !(b[j] < x); });
+                out = std::copy(tmp + i, tmp + i + ka, out);
+                i += ka;
+                if (i == na) {
+                    break;
+                }
+                size_t kb = gallopForward(b + j, nb - j, [&](const T& x) { return x < tmp[i]; });
+                out = std::copy(b + j, b + j + kb, out);
+                j += kb;
+                if (j == nb) {
+                    break;
+                }
+                if (ka < ADAPTIVE_MIN_GALLOP && kb < ADAPTIVE_MIN_GALLOP) {
+                    minGallop++;
+                    break;
+                }
+                if (minGallop > 1) {
+                    minGallop--;
+                }
+            }
+        }
+        std::copy(tmp + i, tmp + na, out); // 右段剩余元素已在原位
+    }
+    
+    // 较短的右段放入缓冲，从后向前归并
+    void mergeHi(T* a, size_t na, T* b, size_t nb) {
+        T* tmp = buffer.data();
+        std::copy(b, b + nb, tmp);
+        T* out = b + nb;
+        size_t i = na, j = nb;
+        while (i > 0 && j > 0) {
+            size_t winsA = 0, winsB = 0;
+            while (i > 0 && j > 0 && winsA < minGallop && winsB < minGallop) {
+                if (tmp[j - 1] < a[i - 1]) {
+                    *--out = a[--i];
+                    winsA++;
+                    winsB = 0;
+                } else {
+                    *--out = tmp[--j];
+                    winsB++;
+                    winsA = 0;
+                }
+            }
+            while (i > 0 && j > 0) {
+                size_t ka = gallopBackward(a, i, [&](const T& x) { return tmp[j - 1] < x; });
+                out = std::copy_backward(a + i - ka, a + i, out);
+                i -= ka;
+                if (i == 0) {
+                    break;
+                }
+                size_t kb = gallopBackward(tmp, j, [&](const T& x) { return !(x < a[i - 1]); });
+                out = std::copy_backward(tmp + j - kb, tmp + j, out);
+                j -= kb;
+                if (j == 0) {
+                    break;
+                }
+                if (ka < ADAPTIVE_MIN_GALLOP && kb < ADAPTIVE_MIN_GALLOP) {
+                    minGallop++;
+                    break;
+                }
+                if (minGallop > 1) {
+                    minGallop--;
+                }
+            }
+        }
+        std::copy(tmp, tmp + j, out - j); // 左段剩余元素已在原位
+    }
+    
+    // 归并栈中第 n 段与第 n + 1 段
+    void mergeAt(size_t n) {
+        T* a = keyed.data() + runs[n].start;
+        size_t na = runs[n].length;
+        T* b = a + na;
+        size_t nb = runs[n + 1].length;
+        runs[n].length = na + nb;
+        runs.erase(runs.begin() + n + 1);
+        
+        // 左段中不大于 b[0] 的前缀、右段中不小于左段末元素的后缀已在最终位置
+        size_t skip = gallopForward(a, na, [&](const T& x) { return !(b[0] < x); });
+        a += skip;
+        na -= skip;
+        if (na == 0) {
+            return;
+        }
+        nb -= gallopBackward(b, nb, [&](const T& x) { return !(x < a[na - 1]); });
+        if (nb == 0) {
+            return;
+        }
+        if (na <= nb) {
+            mergeLo(a, na, b, nb);
+        } else {
+            mergeHi(a, na, b, nb);
+        }
+    }
+    
+    // 维持段栈的长度关系（相邻段长度近似按斐波那契增长），保证归并均衡
+    void mergeCollapse() {
+        while (runs.size() > 1) {
+            size_t n = runs.size() - 2;
+            if ((n > 0 && runs[n - 1].length <= runs[n].length + runs[n + 1].length) ||
+                (n > 1 && runs[n - 2].length <= runs[n - 1].length + runs[n].length)) {
+                if (runs[n - 1].length < runs[n + 1].length) {
+                    n--;
+                }
+            } else if (runs[n].length > runs[n + 1].length) {
+                break;
+            }
+            mergeAt(n);
+        }
+    }
+    
+    void mergeForceCollapse() {
+        while (runs.size() > 1) {
+            size_t n = runs.size() - 2;
+            if (n > 0 && runs[n - 1].length < runs[n + 1].length) {
+                n--;
+            }
+            mergeAt(n);
+        }
+    }
+    
+public:
+    AdaptiveMergeSorter() {
+        runs.reserve(128); // 段栈深度为 O(log n)
+    }
+    
+    // 排序（与 mergeSort(vec, 0, vec.size() - 1) 结果相同）
+    void sort(std::vector<Complex>& vec) {
+        size_t n = vec.size();
+        keyed.resize(n);
+        buffer.resize(n / 2 + 1);
+        for (size_t i = 0; i < n; i++) {
+            keyed[i] = {vec[i].magnitude(), vec[i]};
+        }
+        
+        runs.clear();
+        minGallop = ADAPTIVE_MIN_GALLOP;
+        size_t minRun = minRunLength(n);
+        for (size_t lo = 0; lo < n;) {
+            size_t length = countRun(lo, n);
+            if (length < minRun) {
+                size_t forced = std::min(minRun, n - lo);
+                binaryInsertionSort(lo, length, forced);
+                length = forced;
+            }
+            runs.push_back({lo, length});
+            mergeCollapse();
+            lo += length;
+        }
+        mergeForceCollapse();
+        
+        for (size_t i = 0; i < n; i++) {
+            vec[i] = keyed[i].value;
+        }
+    }
+};
+
+// 自适应归并排序（临时排序器，需要复用缓冲时直接使用 AdaptiveMergeSorter）
+void adaptiveMergeSort(std::vector<Complex>& vec) {
+    AdaptiveMergeSorter().sort(vec);
+}
+
+// ===================== 基数排序 =====================
+
+#define RADIX_BITS 11                          //每趟处理的键位数
+#define RADIX_BUCKETS (1 << RADIX_BITS)        //每趟的桶数
+#define RADIX_KEY_BITS 44                      //参与分桶的键高位数（符号、指数与 32 位尾数）
+#define RADIX_PASSES (RADIX_KEY_BITS / RADIX_BITS)
+
+// 保序映射：double 的大小顺序与映射后无符号整数的大小顺序一致
+inline uint64_t orderedBits(double x) {
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | ((uint64_t)1 << 63);
+}
+
+// orderedBits 的逆映射
+inline double orderedValue(uint64_t key) {
+    uint64_t bits = (key >> 63) ? key & ~((uint64_t)1 << 63) : ~key;
+    double x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// 排序项：模的保序键（完整 64 位，只按高 RADIX_KEY_BITS 位分桶）与元素原下标
+struct RadixItem {
+    uint64_t key;
+    uint64_t index;
+};
+
+inline size_t radixDigit(uint64_t key, int pass) {
+    return (key >> (64 - RADIX_KEY_BITS + pass * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+}
+
+// 分桶所用的高位部分
+inline uint64_t radixPrefix(uint64_t key) {
+    return key >> (64 - RADIX_KEY_BITS);
+}
+
+// 一次扫描统计所有趟的直方图（直方图与元素顺序无关）
+void radixHistograms(const RadixItem* items, size_t n, std::vector<size_t>& counts) {
+    counts.assign(RADIX_PASSES * RADIX_BUCKETS, 0);
+    for (size_t i = 0; i < n; i++) {
+        for (int pass = 0; pass < RADIX_PASSES; pass++) {
+            counts[pass * RADIX_BUCKETS + radixDigit(items[i].key, pass)]++;
+        }
+    }
+}
+
+// 某一趟所有元素落在同一个桶中时可以跳过（如模的高位指数位通常相同）
+inline bool radixPassTrivial(const std::vector<size_t>& counts, int pass, uint64_t anyKey, size_t n) {
+    return counts[pass * RADIX_BUCKETS + radixDigit(anyKey, pass)] == n;
+}
+
+// LSD 基数排序（稳定，只按键的高位），结果留在 items 中
+void radixSortItems(std::vector<RadixItem>& items, std::vector<RadixItem>& scratch) {
+    size_t n = items.size();
+    if (n < 2) {
+        return;
+    }
+    scratch.resize(n);
+    std::vector<size_t> counts;
+    radixHistograms(items.data(), n, counts);
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        if (radixPassTrivial(counts, pass, items[0].key, n)) {
+            continue;
+        }
+        size_t offset[RADIX_BUCKETS];
+        size_t sum = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            offset[b] = sum;
+            sum += counts[pass * RADIX_BUCKETS + b];
+        }
+        for (size_t i = 0; i < n; i++) {
+            scratch[offset[radixDigit(items[i].key, pass)]++] = items[i];
+        }
+        items.swap(scratch);
+    }
+}
+
+// 并行 LSD 基数排序：数组按线程分块，每趟各块先统计本块直方图，
+// 按（桶, 块）顺序求前缀和得到各块在每个桶中的写入位置，再并行分发，结果与顺序版相同
+void radixSortItems(std::vector<RadixItem>& items, std::vector<RadixItem>& scratch, WorkStealingPool& pool) {
+    size_t n = items.size();
+    if (n < 2) {
+        return;
+    }
+    scratch.resize(n);
+    size_t blocks = std::max<size_t>(1, std::min(pool.size(), n / PARALLEL_MERGE_GRAIN));
+    std::vector<size_t> counts;
+    radixHistograms(items.data(), n, counts);
+    std::vector<size_t> local(blocks * RADIX_BUCKETS);
+    
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        if (radixPassTrivial(counts, pass, items[0].key, n)) {
+            continue;
+        }
+        {
+            TaskGroup group(pool);
+            for (size_t t = 0; t < blocks; t++) {
+                group.run([&, t] {
+                    size_t* h = &local[t * RADIX_BUCKETS];
+                    std::fill(h, h + RADIX_BUCKETS, 0);
+                    for (size_t i = n * t / blocks; i < n * (t + 1) / blocks; i++) {
+                        h[radixDigit(items[i].key, pass)]++;
+                    }
+                });
+            }
+        }
+        size_t sum = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            for (size_t t = 0; t < blocks; t++) {
+                size_t c = local[t * RADIX_BUCKETS + b];
+                local[t * RADIX_BUCKETS + b] = sum;
+                sum += c;
+            }
+        }
+        {
+            TaskGroup group(pool);
+            for (size_t t = 0; t < blocks; t++) {
+                group.run([&, t] {
+                    size_t* offset = &local[t * RADIX_BUCKETS];
+                    for (size_t i = n * t / blocks; i < n * (t + 1) / blocks; i++) {
+                        scratch[offset[radixDigit(items[i].key, pass)]++] = items[i];
+                    }
+                });
+            }
+        }
+        items.swap(scratch);
+    }
+}
+
+// 高位与 key 相同的键中最小者对应的模，即 key 所在桶的下界
+inline double radixBucketFloor(uint64_t key) {
+    return orderedValue(radixPrefix(key) << (64 - RADIX_KEY_BITS));
+}
+
+// 修正：只按键高位分桶后，同一桶内的元素按原下标排列；模相差小于容差的元素之间
+// operator< 按实部比较，与单纯按模的顺序也可能不同。把可能互相影响的相邻元素连成链：
+// 下一个元素所在桶的下界与链中最大的模相差不足容差时并入链，因此链尾之后的所有元素
+// 都比链中元素大出至少一个容差，链间不会出现逆序。检查每条链是否已按 operator< 稳定有序，
+// 否则按原下标恢复输入顺序后稳定排序；容差使 operator< 不满足传递性时稳定排序后仍可能
+// 留有相邻逆序，再做一遍插入排序消除。模从完整的键还原，只有链内才访问原数组取实部
+void radixFixUp(std::vector<RadixItem>& items, const std::vector<Complex>& vec) {
+    auto less = [&](const RadixItem& a, const RadixItem& b) {
+        return magnitudeLess(orderedValue(a.key), vec[a.index].getReal(),
+                             orderedValue(b.key), vec[b.index].getReal());
+    };
+    size_t n = items.size();
+    for (size_t start = 0; start < n;) {
+        size_t end = start + 1;
+        uint64_t maxKey = items[start].key;
+        bool ordered = true;
+        while (end < n && !(radixBucketFloor(items[end].key) - orderedValue(maxKey) >= COMPLEX_EPSILON)) {
+            const RadixItem& x = items[end - 1];
+            const RadixItem& y = items[end];
+            if (less(y, x) || (!less(x, y) && y.index < x.index)) {
+                ordered = false;
+            }
+            maxKey = std::max(maxKey, y.key);
+            end++;
+        }
+        if (!ordered) {
+            std::sort(items.begin() + start, items.begin() + end,
+                      [](const RadixItem& a, const RadixItem& b) { return a.index < b.index; });
+            std::stable_sort(items.begin() + start, items.begin() + end, less);
+            for (size_t i = start + 1; i < end; i++) {
+                for (size_t j = i; j > start && less(items[j], items[j - 1]); j--) {
+                    std::swap(items[j], items[j - 1]);
+                }
+            }
+        }
+        start = end;
+    }
+}
+
+// 基数排序的公共部分：建键、排序、修正、按排列取出元素
+template<typename SortItems>
+void radixSortWith(std::vector<Complex>& vec, SortItems sortItems) {
+    size_t n = vec.size();
+    std::vector<RadixItem> items(n);
+    for (size_t i = 0; i < n; i++) {
+        items[i] = {orderedBits(vec[i].magnitude()), i};
+    }
+    std::vector<RadixItem> scratch;
+    sortItems(items, scratch);
+    radixFixUp(items, vec);
+    
+    std::vector<Complex> sorted(n);
+    for (size_t k = 0; k < n; k++) {
+        sorted[k] = vec[items[k].index];
+    }
+    vec.swap(sorted);
+}
+
+// 基数排序：按模的保序键高位做 LSD 基数排序，再修正高位相同或容差内的相邻元素。
+// 结果中没有相邻的 operator< 逆序；不存在模在容差内成链的元素时与稳定排序（mergeSort）相同
+void radixSort(std::vector<Complex>& vec) {
+    radixSortWith(vec, [](std::vector<RadixItem>& items, std::vector<RadixItem>& scratch) {
+        radixSortItems(items, scratch);
+    });
+}
+
+// 并行基数排序（每块独立直方图）
+void radixSort(std::vector<Complex>& vec, WorkStealingPool& pool) {
+    radixSortWith(vec, [&](std::vector<RadixItem>& items, std::vector<RadixItem>& scratch) {
+        radixSortItems(items, scratch, pool);
+    });
+}
+
+// 区间查找算法，找出模介于[m1, m2)的所有元素
+std::vector<Complex> rangeSearch(const std::vector<Complex>& vec, double m1, double m2) {
+    std::vector<Complex> result;
+    for (const Complex& c : vec) {
+        double mag = c.magnitude();
+        if (mag >= m1 && mag < m2) {
+            result.push_back(c);
+        }
+    }
+    // 按照排序规则排序结果
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// ===================== 模索引 =====================
+
+// 模索引：按（模, 原位置）升序保存元素的模、元素副本和原位置（排列）。
+// 区间查询用二分查找定位，返回索引内部存储上的迭代器区间，不复制元素；
+// 插入、删除时就地更新而不重建，与所索引向量的 insertComplex / removeComplex 保持同步。
+// 每次编辑的代价为 O(n)：要平移所有存储的位置，并在三个数组中间插入或删除一项（都是顺序访存），
+// 与向量本身的插入、删除同阶，省去的是 O(n log n) 的重建
+class MagnitudeIndex {
+public:
+    typedef std::vector<Complex>::const_iterator iterator;
+    
+    // 查询结果：索引中连续的一段，按模升序
+    struct Range {
+        iterator first;
+        iterator last;
+        size_t offset; // 在索引中的起始序号
+        
+        iterator begin() const { return first; }
+        iterator end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+    
+private:
+    std::vector<double> mags;       // 有序的模
+    std::vector<Complex> values;    // 与 mags 对应的元素
+    std::vector<size_t> positions;  // 与 mags 对应的元素在原向量中的位置
+    
+    // 第一个模不小于 m 的序号
+    size_t lowerBound(double m) const {
+        return std::lower_bound(mags.begin(), mags.end(), m) - mags.begin();
+    }
+    
+    // 从 from 开始指数查找第一个模不小于 m 的序号（要求 mags[from - 1] < m）
+    size_t gallopFrom(size_t from, double m) const {
+        size_t n = mags.size();
+        size_t step = 1;
+        size_t lo = from;
+        size_t hi = from;
+        while (hi < n && mags[hi] < m) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        hi = std::min(hi, n);
+        return std::lower_bound(mags.begin() + lo, mags.begin() + hi, m) - mags.begin();
+    }
+    
+    Range makeRange(size_t first, size_t last) const {
+        if (last < first) {
+            last = first;
+        }
+        return {values.begin() + first, values.begin() + last, first};
+    }
+    
+public:
+    MagnitudeIndex() {}
+    
+    explicit MagnitudeIndex(const std::vector<Complex>& vec) {
+        std::vector<std::pair<double, size_t>> order(vec.size());
+        for (size_t i = 0; i < vec.size(); i++) {
+            order[i] = {vec[i].magnitude(), i};
+        }
+        std::sort(order.begin(), order.end());
+        mags.reserve(vec.size());
+        values.reserve(vec.size());
+        positions.reserve(vec.size());
+        for (const auto& entry : order) {
+            mags.push_back(entry.first);
+            values.push_back(vec[entry.second]);
+            positions.push_back(entry.second);
+        }
+    }
+    
+    size_t size() const {
+        return mags.size();
+    }
+    
+    // 序号为 rank 的元素在原向量中的位置
+    size_t position(size_t rank) const {
+        return positions[rank];
+    }
+    
+    // 模在 [m1, m2) 内的元素，O(log n)
+    Range range(double m1, double m2) const {
+        return makeRange(lowerBound(m1), lowerBound(m2));
+    }
+    
+    // 批量查询：把所有端点排序后从左到右扫描一遍，每个端点从上一个端点处指数查找，
+    // 总代价 O(q log q + q log(n / q))；结果按查询顺序返回
+    std::vector<Range> ranges(const std::vector<std::pair<double, double>>& queries) const {
+        std::vector<std::pair<double, size_t>> endpoints; // (端点值, 查询编号 * 2 + 是否为右端点)
+        endpoints.reserve(queries.size() * 2);
+        for (size_t q = 0; q < queries.size(); q++) {
+            endpoints.push_back({queries[q].first, q * 2});
+            endpoints.push_back({queries[q].second, q * 2 + 1});
+        }
+        std::sort(endpoints.begin(), endpoints.end(),
+                  [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+                      return a.first < b.first;
+                  });
+        
+        std::vector<size_t> bounds(endpoints.size());
+        size_t cursor = 0;
+        for (const auto& endpoint : endpoints) {
+            cursor = gallopFrom(cursor, endpoint.first);
+            bounds[endpoint.second] = cursor;
+        }
+        
+        std::vector<Range> result;
+        result.reserve(queries.size());
+        for (size_t q = 0; q < queries.size(); q++) {
+            result.push_back(makeRange(bounds[q * 2], bounds[q * 2 + 1]));
+        }
+        return result;
+    }
+    
+    // 原向量在 position 处插入了 c：位置不小于 position 的元素后移一位，新元素按模插入（O(n)）
+    void insert(size_t position, const Complex& c) {
+        for (size_t& p : positions) {
+            p += p >= position;
+        }
+        double mag = c.magnitude();
+        size_t rank = lowerBound(mag);
+        while (rank < mags.size() && mags[rank] == mag && positions[rank] < position) {
+            rank++;
+        }
+        mags.insert(mags.begin() + rank, mag);
+        values.insert(values.begin() + rank, c);
+        positions.insert(positions.begin() + rank, position);
+    }
+    
+    // 原向量删除了 position 处的元素（O(n)，按位置线性查找）
+    void remove(size_t position) {
+        size_t rank = std::find(positions.begin(), positions.end(), position) - positions.begin();
+        if (rank == positions.size()) {
+            return;
+        }
+        mags.erase(mags.begin() + rank);
+        values.erase(values.begin() + rank);
+        positions.erase(positions.begin() + rank);
+        for (size_t& p : positions) {
+            p -= p > position;
+        }
+    }
+};
+
+// 插入复数并同步更新索引
+void insertComplex(std::vector<Complex>& vec, MagnitudeIndex& index, int position, const Complex& c) {
+    if (position >= 0 && position <= static_cast<int>(vec.size())) {
+        vec.insert(vec.begin() + position, c);
+        index.insert(position, c);
+    }
+}
+
+// 删除复数并同步更新索引
+bool removeComplex(std::vector<Complex>& vec, MagnitudeIndex& index, int position) {
+    if (removeComplex(vec, position)) {
+        index.remove(position);
+        return true;
+    }
+    return false;
+}
+
+// 区间查找（索引版本）：用索引定位命中元素，不扫描整个向量；
+// 命中元素按原位置恢复扫描顺序后再排序，结果与 rangeSearch(vec, m1, m2) 完全相同
+std::vector<Complex> rangeSearch(const MagnitudeIndex& index, double m1, double m2) {
+    MagnitudeIndex::Range hits = index.range(m1, m2);
+    std::vector<std::pair<size_t, Complex>> found;
+    found.reserve(hits.size());
+    for (size_t k = 0; k < hits.size(); k++) {
+        found.push_back({index.position(hits.offset + k), hits.first[k]});
+    }
+    std::sort(found.begin(), found.end(),
+              [](const std::pair<size_t, Complex>& a, const std::pair<size_t, Complex>& b) {
+                  return a.first < b.first;
+              });
+    
+    std::vector<Complex> result;
+    result.reserve(found.size());
+    for (const auto& entry : found) {
+        result.push_back(entry.second);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// ===================== 哈希索引 =====================
+
+#define HASH_CELL_WIDTH (16 * COMPLEX_EPSILON) //量化网格宽度，远大于容差，查找时通常只需探测一个格子
+#define HASH_CELL_LIMIT 281474976710656.0      //格子坐标上限 2^48，超出（或非有限值）的统一归入溢出格
+#define HASH_OVERFLOW_CELL INT64_MAX           //溢出格坐标
+#define HASH_MIN_CAPACITY 16                   //哈希表最小容量
+
+// 格子坐标 q 超出范围时归入溢出格
+int64_t hashCellOf(double q) {
+    return std::fabs(q) <= HASH_CELL_LIMIT ? static_cast<int64_t>(q) : HASH_OVERFLOW_CELL;
+}
+
+// 坐标所在的格子
+int64_t hashQuantize(double coordinate) {
+    return hashCellOf(std::floor(coordinate / HASH_CELL_WIDTH));
+}
+
+// 与 coordinate 距离小于容差的值可能所在的格子（最多 3 个），区间两端各放宽几个舍入误差
+int hashNeighbourCells(double coordinate, int64_t out[3]) {
+    double slack = (std::fabs(coordinate) / HASH_CELL_WIDTH + 1) * 1e-15;
+    double lo = std::floor((coordinate - COMPLEX_EPSILON) / HASH_CELL_WIDTH - slack);
+    double hi = std::floor((coordinate + COMPLEX_EPSILON) / HASH_CELL_WIDTH + slack);
+    int count = 0;
+    if (!(lo >= -HASH_CELL_LIMIT && hi <= HASH_CELL_LIMIT)) {
+        out[count++] = HASH_OVERFLOW_CELL;
+        lo = std::max(lo, -HASH_CELL_LIMIT);
+        hi = std::min(hi, HASH_CELL_LIMIT);
+    }
+    for (double q = lo; q <= hi; q++) {
+        out[count++] = static_cast<int64_t>(q);
+    }
+    return count;
+}
+
+// 浮点数的二进制表示，用于判断两个值是否逐位相同
+uint64_t doubleBits(double value) {
+    uint64_t result;
+    std::memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+// 格子的散列值
+size_t hashCell(int64_t x, int64_t y) {
+    uint64_t h = static_cast<uint64_t>(x) * 0x9E3779B97F4A7C15ULL;
+    h ^= static_cast<uint64_t>(y) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+// 哈希索引：把实部、虚部量化到网格上，开放寻址（线性探测）存放。每个槽位是一组逐位相同的值，
+// 按所在格子散列，组内位置按升序串成双向链表。查找时探测与目标距离小于容差的格子（通常只有一个），
+// 用 operator== 比较各组的值，返回与线性查找相同的第一个匹配位置；期望 O(1)，与重复次数无关。
+// 节点保存的是元素在原向量中的位置，插入、删除后要平移所有位置，每次同步为 O(n)（顺序扫描，
+// 与向量本身的插入、删除同阶）；因此循环调用 removeComplexByValue 整体仍是 O(n^2)，只省去了逐个比较
+class ComplexHashIndex {
+    static const uint32_t NONE = UINT32_MAX;       // 空链表 / 无后继
+    static const uint32_t VACANT = UINT32_MAX - 1; // 从未使用的槽位
+    
+    struct Group {
+        int64_t x;      // 所在格子
+        int64_t y;
+        uint64_t real;  // 值的二进制表示
+        uint64_t imag;
+        uint32_t head;  // VACANT 表示空槽位，NONE 表示组内已无元素
+        uint32_t tail;
+    };
+    
+    struct Link {
+        uint32_t prev;
+        uint32_t next;
+    };
+    
+    std::vector<Group> groups;     // 开放寻址表，容量为 2 的幂
+    size_t usedGroups = 0;         // 已占用的槽位（含已无元素的组）
+    std::vector<size_t> positions; // 每个节点在原向量中的位置
+    std::vector<Link> links;       // 组内链表
+    std::vector<uint32_t> slots;   // 每个节点所在的槽位
+    
+    static double fromBits(uint64_t value) {
+        double result;
+        std::memcpy(&result, &value, sizeof(result));
+        return result;
+    }
+    
+    // 值为 (real, imag) 的组所在槽位，不存在时返回它应放入的空槽位
+    size_t locate(int64_t x, int64_t y, uint64_t real, uint64_t imag) const {
+        size_t mask = groups.size() - 1;
+        size_t slot = hashCell(x, y) & mask;
+        while (groups[slot].head != VACANT && (groups[slot].real != real || groups[slot].imag != imag)) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+    
+    // 扩容并丢弃已无元素的组
+    void rehash(size_t capacity) {
+        std::vector<Group> old(capacity, Group{0, 0, 0, 0, VACANT, VACANT});
+        old.swap(groups);
+        usedGroups = 0;
+        for (const Group& group : old) {
+            if (group.head == VACANT || group.head == NONE) {
+                continue;
+            }
+            size_t slot = locate(group.x, group.y, group.real, group.imag);
+            groups[slot] = group;
+            usedGroups++;
+            for (uint32_t node = group.head; node != NONE; node = links[node].next) {
+                slots[node] = static_cast<uint32_t>(slot);
+            }
+        }
+    }
+    
+    // 值 c 所在组的槽位，不存在时新建
+    size_t acquire(const Complex& c) {
+        if ((usedGroups + 1) * 2 > groups.size()) {
+            size_t live = 0;
+            for (const Group& group : groups) {
+                live += group.head != VACANT && group.head != NONE;
+            }
+            size_t capacity = HASH_MIN_CAPACITY;
+            while (capacity < (live + 1) * 4) {
+                capacity *= 2;
+            }
+            rehash(capacity);
+        }
+        int64_t x = hashQuantize(c.getReal());
+        int64_t y = hashQuantize(c.getImag());
+        uint64_t real = doubleBits(c.getReal());
+        uint64_t imag = doubleBits(c.getImag());
+        size_t slot = locate(x, y, real, imag);
+        if (groups[slot].head == VACANT) {
+            groups[slot] = Group{x, y, real, imag, NONE, NONE};
+            usedGroups++;
+        }
+        return slot;
+    }
+    
+    // 新建节点并按位置插入所在组的链表
+    void link(size_t position, const Complex& c) {
+        uint32_t node = static_cast<uint32_t>(positions.size());
+        size_t slot = acquire(c);
+        positions.push_back(position);
+        links.push_back(Link{NONE, NONE});
+        slots.push_back(static_cast<uint32_t>(slot));
+        
+        Group& group = groups[slot];
+        if (group.head == NONE) {
+            group.head = group.tail = node;
+            return;
+        }
+        // 顺序追加最常见，从尾部向前找插入点
+        uint32_t after = group.tail;
+        while (after != NONE && positions[after] > position) {
+            after = links[after].prev;
+        }
+        uint32_t before = after == NONE ? group.head : links[after].next;
+        links[node] = Link{after, before};
+        (after == NONE ? group.head : links[after].next) = node;
+        (before == NONE ? group.tail : links[before].prev) = node;
+    }
+    
+    // 摘除节点，并把最后一个节点移到它的编号上，保持编号连续
+    void unlink(uint32_t node) {
+        Group& group = groups[slots[node]];
+        Link l = links[node];
+        (l.prev == NONE ? group.head : links[l.prev].next) = l.next;
+        (l.next == NONE ? group.tail : links[l.next].prev) = l.prev;
+        
+        uint32_t last = static_cast<uint32_t>(positions.size() - 1);
+        if (node != last) {
+            positions[node] = positions[last];
+            links[node] = links[last];
+            slots[node] = slots[last];
+            Group& moved = groups[slots[node]];
+            (links[node].prev == NONE ? moved.head : links[links[node].prev].next) = node;
+            (links[node].next == NONE ? moved.tail : links[links[node].next].prev) = node;
+        }
+        positions.pop_back();
+        links.pop_back();
+        slots.pop_back();
+    }
+    
+public:
+    ComplexHashIndex() : groups(HASH_MIN_CAPACITY, Group{0, 0, 0, 0, VACANT, VACANT}) {}
+    
+    explicit ComplexHashIndex(const std::vector<Complex>& vec) : ComplexHashIndex() {
+        size_t capacity = HASH_MIN_CAPACITY;
+        while (capacity < vec.size() * 2) {
+            capacity *= 2;
+        }
+        rehash(capacity);
+        positions.reserve(vec.size());
+        links.reserve(vec.size());
+        slots.reserve(vec.size());
+        for (size_t i = 0; i < vec.size(); i++) {
+            link(i, vec[i]);
+        }
+    }
+    
+    size_t size() const {
+        return positions.size();
+    }
+    
+    // 第一个与 target 相等的元素位置，未找到返回 -1
+    int find(const Complex& target) const {
+        int64_t xs[3], ys[3];
+        int nx = hashNeighbourCells(target.getReal(), xs);
+        int ny = hashNeighbourCells(target.getImag(), ys);
+        size_t best = SIZE_MAX;
+        size_t mask = groups.size() - 1;
+        for (int i = 0; i < nx; i++) {
+            for (int j = 0; j < ny; j++) {
+                // 同一格子的组散列到同一起点，沿探测序列检查直到空槽位
+                for (size_t slot = hashCell(xs[i], ys[j]) & mask; groups[slot].head != VACANT; slot = (slot + 1) & mask) {
+                    const Group& group = groups[slot];
+                    if (group.head == NONE || group.x != xs[i] || group.y != ys[j] || positions[group.head] >= best) {
+                        continue;
+                    }
+                    if (Complex(fromBits(group.real), fromBits(group.imag)) == target) {
+                        best = positions[group.head];
+                    }
+                }
+            }
+        }
+        return best == SIZE_MAX ? -1 : static_cast<int>(best);
+    }
+    
+    // 原向量在 position 处插入了 c（O(n)，平移所有位置）
+    void insert(size_t position, const Complex& c) {
+        for (size_t& p : positions) {
+            p += p >= position;
+        }
+        link(position, c);
+    }
+    
+    // 原向量删除了 position 处的元素（O(n)，平移所有位置）
+    void remove(size_t position) {
+        uint32_t found = NONE;
+        for (size_t node = 0; node < positions.size(); node++) {
+            if (positions[node] == position) {
+                found = static_cast<uint32_t>(node);
+            }
+            positions[node] -= positions[node] > position;
+        }
+        if (found != NONE) {
+            unlink(found);
+        }
+    }
+};
+
+// 查找复数（哈希索引版本），结果与 findComplex(vec, target) 相同
+int findComplex(const ComplexHashIndex& index, const Complex& target) {
+    return index.find(target);
+}
+
+// 插入复数并同步更新哈希索引
+void insertComplex(std::vector<Complex>& vec, ComplexHashIndex& index, int position, const Complex& c) {
+    if (position >= 0 && position <= static_cast<int>(vec.size())) {
+        vec.insert(vec.begin() + position, c);
+        index.insert(position, c);
+    }
+}
+
+// 删除复数并同步更新哈希索引
+bool removeComplex(std::vector<Complex>& vec, ComplexHashIndex& index, int position) {
+    if (removeComplex(vec, position)) {
+        index.remove(position);
+        return true;
+    }
+    return false;
+}
+
+// 删除第一个匹配的复数（哈希索引版本）：查找期望 O(1)，不再逐个比较；
+// 删除本身连同索引同步仍是 O(n)
+bool removeComplexByValue(std::vector<Complex>& vec, ComplexHashIndex& index, const Complex& target) {
+    int position = index.find(target);
+    return position >= 0 && removeComplex(vec, index, position);
+}
+
+#define UNIQUE_PREFETCH 8          //去重时提前预取的元素数
+#define UNIQUE_SAMPLE 4096         //估计重复比例的抽样数
+#define UNIQUE_MIN_DUPLICATES 0.25 //抽样重复比例不低于此值时有序去重才先做哈希去重
+
+// 容差网格上的复数集合：开放寻址（线性探测），按值所在格子散列，同一格子的值从同一起点开始探测；只增不删
+class ComplexHashSet {
+    struct Slot {
+        Complex value;
+        bool used;
+    };
+    
+    std::vector<Slot> slots; // 容量为 2 的幂
+    size_t count = 0;
+    
+    static size_t hashOf(const Complex& c) {
+        return hashCell(hashQuantize(c.getReal()), hashQuantize(c.getImag()));
+    }
+    
+    void place(const Complex& c) {
+        size_t mask = slots.size() - 1;
+        size_t i = hashOf(c) & mask;
+        while (slots[i].used) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = Slot{c, true};
+    }
+    
+    void reserveSlots(size_t expected) {
+        size_t capacity = HASH_MIN_CAPACITY;
+        while (capacity < expected * 2) {
+            capacity *= 2;
+        }
+        if (capacity <= slots.size()) {
+            return;
+        }
+        std::vector<Slot> old(capacity, Slot{Complex(), false});
+        old.swap(slots);
+        for (const Slot& slot : old) {
+            if (slot.used) {
+                place(slot.value);
+            }
+        }
+    }
+    
+    // 格子 (x, y) 中是否有满足 match 的值
+    template<typename Match>
+    bool probe(int64_t x, int64_t y, Match match) const {
+        size_t mask = slots.size() - 1;
+        for (size_t i = hashCell(x, y) & mask; slots[i].used; i = (i + 1) & mask) {
+            if (match(slots[i].value)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void add(const Complex& c) {
+        reserveSlots(count + 1);
+        place(c);
+        count++;
+    }
+    
+public:
+    explicit ComplexHashSet(size_t expected = 0) {
+        reserveSlots(expected);
+    }
+    
+    size_t size() const {
+        return count;
+    }
+    
+    // 预取 c 所在格子的探测起点，批量插入时提前几个元素调用
+    void prefetch(const Complex& c) const {
+        __builtin_prefetch(&slots[hashOf(c) & (slots.size() - 1)]);
+    }
+    
+    // 是否有与 c 相等（容差内）的值
+    bool contains(const Complex& c) const {
+        int64_t xs[3], ys[3];
+        int nx = hashNeighbourCells(c.getReal(), xs);
+        int ny = hashNeighbourCells(c.getImag(), ys);
+        for (int i = 0; i < nx; i++) {
+            for (int j = 0; j < ny; j++) {
+                if (probe(xs[i], ys[j], [&](const Complex& value) { return value == c; })) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    
+    // 是否有与 c 逐位相同的值
+    bool containsExact(const Complex& c) const {
+        uint64_t real = doubleBits(c.getReal());
+        uint64_t imag = doubleBits(c.getImag());
+        return probe(hashQuantize(c.getReal()), hashQuantize(c.getImag()), [&](const Complex& value) {
+            return doubleBits(value.getReal()) == real && doubleBits(value.getImag()) == imag;
+        });
+    }
+    
+    // 没有相等的值时加入并返回 true
+    bool insert(const Complex& c) {
+        if (contains(c)) {
+            return false;
+        }
+        add(c);
+        return true;
+    }
+    
+    // 没有逐位相同的值时加入并返回 true；不等于自身的值（含 NaN 或无穷）总是返回 true
+    bool insertExact(const Complex& c) {
+        if (!(c == c)) {
+            return true;
+        }
+        if (containsExact(c)) {
+            return false;
+        }
+        add(c);
+        return true;
+    }
+};
+
+// 保序去重：按原顺序保留元素，删除与之前已保留元素相等（容差内）的元素；期望 O(n)
+void uniqueVectorStable(std::vector<Complex>& vec) {
+    ComplexHashSet kept(vec.size());
+    size_t out = 0;
+    for (size_t i = 0; i < vec.size(); i++) {
+        if (i + UNIQUE_PREFETCH < vec.size()) {
+            kept.prefetch(vec[i + UNIQUE_PREFETCH]);
+        }
+        if (kept.insert(vec[i])) {
+            vec[out++] = vec[i];
+        }
+    }
+    vec.resize(out);
+}
+
+// 保序删除 [begin, end) 中逐位相同的重复，返回剩余元素个数
+size_t removeExactDuplicates(Complex* begin, Complex* end) {
+    ComplexHashSet kept(end - begin);
+    Complex* out = begin;
+    for (Complex* it = begin; it != end; ++it) {
+        if (end - it > UNIQUE_PREFETCH) {
+            kept.prefetch(it[UNIQUE_PREFETCH]);
+        }
+        if (kept.insertExact(*it)) {
+            *out++ = *it;
+        }
+    }
+    return out - begin;
+}
+
+// 等距抽样估计逐位相同的重复所占比例
+double exactDuplicateRatio(const std::vector<Complex>& vec) {
+    size_t samples = std::min<size_t>(vec.size(), UNIQUE_SAMPLE);
+    if (samples == 0) {
+        return 0;
+    }
+    ComplexHashSet seen(samples);
+    size_t duplicates = 0;
+    for (size_t k = 0; k < samples; k++) {
+        duplicates += !seen.insertExact(vec[vec.size() / samples * k]);
+    }
+    return static_cast<double>(duplicates) / samples;
+}
+
+// 有序去重：重复较多时先用哈希删除逐位相同的重复，只对剩余元素排序、相邻去重。
+// 模在容差内的元素总是彼此相等（==）且不成链时（如一般的随机数据），结果与 uniqueVector 按 == 逐个相同；
+// 否则（模在容差内成链，或有共轭这类模、实部相同而虚部不同的元素）提前去重改变了 std::sort 看到的输入，
+// 相等元素的排列和保留下来的元素都可能与 uniqueVector 不同
+void uniqueVectorSorted(std::vector<Complex>& vec) {
+    if (exactDuplicateRatio(vec) >= UNIQUE_MIN_DUPLICATES) {
+        vec.resize(removeExactDuplicates(vec.data(), vec.data() + vec.size()));
+    }
+    uniqueVector(vec);
+}
+
+// 并行保序去重：各分片并行删除片内逐位相同的重复，拼接后再做一遍保序去重，
+// 结果与 uniqueVectorStable 相同（等于自身的元素与逐位相同的前一个元素比较结果都相同，提前删除不影响保留哪些元素）
+void uniqueVectorParallel(std::vector<Complex>& vec, WorkStealingPool& pool) {
+    size_t shards = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, vec.size() / PARALLEL_SORT_CUTOFF));
+    std::vector<size_t> kept(shards);
+    size_t n = vec.size();
+    parallelFor(pool, shards, 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; s++) {
+            kept[s] = removeExactDuplicates(vec.data() + n * s / shards, vec.data() + n * (s + 1) / shards);
+        }
+    });
+    size_t out = kept[0];
+    for (size_t s = 1; s < shards; s++) {
+        Complex* first = vec.data() + n * s / shards;
+        std::copy(first, first + kept[s], vec.data() + out);
+        out += kept[s];
+    }
+    vec.resize(out);
+    uniqueVectorStable(vec);
+}
+
+// ===================== 分块序列 =====================
+
+#define CHUNK_CAPACITY 1024 //每块最多元素数，超过时一分为二
+#define CHUNK_MERGE_SIZE (CHUNK_CAPACITY / 4) //块小于此值时尝试与后一块合并
+
+// 分块序列：元素分散在若干连续小块中，并记录每块起始下标。
+// 按位置插入、删除只移动一个块内的元素和 O(n / CHUNK_CAPACITY) 个起始下标，
+// 下标访问二分定位块，扫描时逐块访问连续内存
+class ChunkedComplexList {
+private:
+    std::vector<std::vector<Complex>> chunks;
+    std::vector<size_t> starts; // starts[i] 为第 i 块第一个元素的下标
+    size_t count = 0;
+    
+    // 下标 index 所在的块
+    size_t locate(size_t index) const {
+        return std::upper_bound(starts.begin(), starts.end(), index) - starts.begin() - 1;
+    }
+    
+    // 重新计算第 from 块及之后的起始下标
+    void reindex(size_t from) {
+        starts.resize(chunks.size());
+        for (size_t i = from; i < chunks.size(); i++) {
+            starts[i] = i == 0 ? 0 : starts[i - 1] + chunks[i - 1].size();
+        }
+    }
+    
+public:
+    ChunkedComplexList() {}
+    
+    explicit ChunkedComplexList(const std::vector<Complex>& vec) {
+        assign(vec);
+    }
+    
+    // 从向量导入，每块填到容量的一半，为插入留出余量
+    void assign(const std::vector<Complex>& vec) {
+        chunks.clear();
+        size_t fill = CHUNK_CAPACITY / 2;
+        for (size_t i = 0; i < vec.size(); i += fill) {
+            size_t end = std::min(vec.size(), i + fill);
+            chunks.emplace_back(vec.begin() + i, vec.begin() + end);
+            chunks.back().reserve(CHUNK_CAPACITY + 1);
+        }
+        count = vec.size();
+        reindex(0);
+    }
+    
+    // 导出为向量
+    std::vector<Complex> toVector() const {
+        std::vector<Complex> result;
+        result.reserve(count);
+        for (const auto& chunk : chunks) {
+            result.insert(result.end(), chunk.begin(), chunk.end());
+        }
+        return result;
+    }
+    
+    size_t size() const {
+        return count;
+    }
+    
+    bool empty() const {
+        return count == 0;
+    }
+    
+    const Complex& operator[](size_t index) const {
+        size_t i = locate(index);
+        return chunks[i][index - starts[i]];
+    }
+    
+    Complex& operator[](size_t index) {
+        size_t i = locate(index);
+        return chunks[i][index - starts[i]];
+    }
+    
+    // 逐块访问
+    size_t chunkCount() const {
+        return chunks.size();
+    }
+    
+    const std::vector<Complex>& chunk(size_t i) const {
+        return chunks[i];
+    }
+    
+    std::vector<Complex>& chunk(size_t i) {
+        return chunks[i];
+    }
+    
+    // 在 index 处插入，index 可以等于 size()
+    void insert(size_t index, const Complex& c) {
+        if (chunks.empty()) {
+            chunks.emplace_back();
+            chunks.back().reserve(CHUNK_CAPACITY + 1);
+            reindex(0);
+        }
+        size_t i = index == count ? chunks.size() - 1 : locate(index);
+        std::vector<Complex>& target = chunks[i];
+        target.insert(target.begin() + (index - starts[i]), c);
+        count++;
+        
+        if (target.size() > CHUNK_CAPACITY) {
+            std::vector<Complex> upper(target.begin() + target.size() / 2, target.end());
+            upper.reserve(CHUNK_CAPACITY + 1);
+            target.resize(target.size() / 2);
+            chunks.insert(chunks.begin() + i + 1, std::move(upper));
+        }
+        reindex(i + 1);
+    }
+    
+    void push_back(const Complex& c) {
+        insert(count, c);
+    }
+    
+    // 删除 index 处的元素
+    void erase(size_t index) {
+        size_t i = locate(index);
+        std::vector<Complex>& target = chunks[i];
+        target.erase(target.begin() + (index - starts[i]));
+        count--;
+        
+        if (target.empty()) {
+            chunks.erase(chunks.begin() + i);
+        } else if (target.size() < CHUNK_MERGE_SIZE && i + 1 < chunks.size() &&
+                   target.size() + chunks[i + 1].size() <= CHUNK_CAPACITY) {
+            target.insert(target.end(), chunks[i + 1].begin(), chunks[i + 1].end());
+            chunks.erase(chunks.begin() + i + 1);
+        }
+        reindex(i);
+    }
+    
+    void clear() {
+        chunks.clear();
+        starts.clear();
+        count = 0;
+    }
+};
+
+// 以下为分块序列上的同名操作，语义与向量版本相同
+
+// 查找复数，逐块扫描
+int findComplex(const ChunkedComplexList& list, const Complex& target) {
+    size_t base = 0;
+    for (size_t i = 0; i < list.chunkCount(); i++) {
+        const std::vector<Complex>& chunk = list.chunk(i);
+        for (size_t j = 0; j < chunk.size(); j++) {
+            if (chunk[j] == target) {
+                return static_cast<int>(base + j);
+            }
+        }
+        base += chunk.size();
+    }
+    return -1;
+}
+
+// 在指定位置插入复数
+void insertComplex(ChunkedComplexList& list, int index, const Complex& c) {
+    if (index >= 0 && index <= static_cast<int>(list.size())) {
+        list.insert(index, c);
+    }
+}
+
+// 删除指定位置的复数
+bool removeComplex(ChunkedComplexList& list, int index) {
+    if (index >= 0 && index < static_cast<int>(list.size())) {
+        list.erase(index);
+        return true;
+    }
+    return false;
+}
+
+// 删除第一个匹配的复数
+bool removeComplexByValue(ChunkedComplexList& list, const Complex& target) {
+    return removeComplex(list, findComplex(list, target));
+}
+
+// 置乱
+void shuffleVector(ChunkedComplexList& list) {
+    std::vector<Complex> vec = list.toVector();
+    shuffleVector(vec);
+    list.assign(vec);
+}
+
+// 向量唯一化
+void uniqueVector(ChunkedComplexList& list) {
+    std::vector<Complex> vec = list.toVector();
+    uniqueVector(vec);
+    list.assign(vec);
+}
+
+// 排序（结果与 mergeSort 相同）
+void mergeSort(ChunkedComplexList& list) {
+    std::vector<Complex> vec = list.toVector();
+    mergeSortKeyed(vec);
+    list.assign(vec);
+}
+
+// 区间查找，逐块扫描
+std::vector<Complex> rangeSearch(const ChunkedComplexList& list, double m1, double m2) {
+    std::vector<Complex> result;
+    for (size_t i = 0; i < list.chunkCount(); i++) {
+        for (const Complex& c : list.chunk(i)) {
+            double mag = c.magnitude();
+            if (mag >= m1 && mag < m2) {
+                result.push_back(c);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// ===================== 结构数组形式的复数集合 =====================
+
+#define COMPLEX_ALIGNMENT 64 //列数据的对齐字节数（一条缓存行，也满足 AVX-512 对齐加载）
+
+// 按 COMPLEX_ALIGNMENT 对齐的分配器
+template<typename T>
+struct AlignedAllocator {
+    typedef T value_type;
+    
+    AlignedAllocator() {}
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+    
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(COMPLEX_ALIGNMENT)));
+    }
+    
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(COMPLEX_ALIGNMENT));
+    }
+    
+    template<typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+typedef std::vector<double, AlignedAllocator<double>> AlignedColumn;
+
+// SIMD 基本运算：按编译目标选择 AVX-512 / AVX2，否则退化为标量。
+// 模按 sqrt(re*re + im*im) 逐步计算（不用 FMA），与 Complex::magnitude() 结果逐位一致
+#if defined(__AVX512F__)
+#define COMPLEX_SIMD_NAME "AVX-512"
+#define COMPLEX_SIMD_WIDTH 8
+typedef __m512d simd_vec;
+inline simd_vec vload(const double* p) { return _mm512_load_pd(p); }
+inline void vstore(double* p, simd_vec v) { _mm512_store_pd(p, v); }
+inline simd_vec vset1(double x) { return _mm512_set1_pd(x); }
+inline simd_vec vsub(simd_vec a, simd_vec b) { return _mm512_sub_pd(a, b); }
+inline simd_vec vnorm(simd_vec re, simd_vec im) {
+    return _mm512_add_pd(_mm512_mul_pd(re, re), _mm512_mul_pd(im, im));
+}
+inline simd_vec vsqrt(simd_vec a) { return _mm512_maskz_sqrt_pd(0xFF, a); }
+inline simd_vec vabs(simd_vec a) {
+    return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a),
+                                                _mm512_set1_epi64(~((long long)1 << 63))));
+}
+inline unsigned vltmask(simd_vec a, simd_vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+inline unsigned vgemask(simd_vec a, simd_vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+#elif defined(__AVX2__)
+#define COMPLEX_SIMD_NAME "AVX2"
+#define COMPLEX_SIMD_WIDTH 4
+typedef __m256d simd_vec;
+inline simd_vec vload(const double* p) { return _mm256_load_pd(p); }
+inline void vstore(double* p, simd_vec v) { _mm256_store_pd(p, v); }
+inline simd_vec vset1(double x) { return _mm256_set1_pd(x); }
+inline simd_vec vsub(simd_vec a, simd_vec b) { return _mm256_sub_pd(a, b); }
+inline simd_vec vnorm(simd_vec re, simd_vec im) {
+    return _mm256_add_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im));
+}
+inline simd_vec vsqrt(simd_vec a) { return _mm256_sqrt_pd(a); }
+inline simd_vec vabs(simd_vec a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+inline unsigned vltmask(simd_vec a, simd_vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+inline unsigned vgemask(simd_vec a, simd_vec b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GE_OQ)); }
+#else
+#define COMPLEX_SIMD_NAME "scalar"
+#define COMPLEX_SIMD_WIDTH 1
+typedef double simd_vec;
+inline simd_vec vload(const double* p) { return *p; }
+inline void vstore(double* p, simd_vec v) { *p = v; }
+inline simd_vec vset1(double x) { return x; }
+inline simd_vec vsub(simd_vec a, simd_vec b) { return a - b; }
+inline simd_vec vnorm(simd_vec re, simd_vec im) { return re * re + im * im; }
+inline simd_vec vsqrt(simd_vec a) { return sqrt(a); }
+inline simd_vec vabs(simd_vec a) { return fabs(a); }
+inline unsigned vltmask(simd_vec a, simd_vec b) { return a < b; }
+inline unsigned vgemask(simd_vec a, simd_vec b) { return a >= b; }
+#endif
+
+// 位掩码：第 i 个元素对应第 i / 64 个字的第 i % 64 位
+typedef std::vector<uint64_t> BitMask;
+
+// 实部、虚部两列（及可选的模列）的只读视图，不拥有数据。
+// 各列须按 COMPLEX_ALIGNMENT 对齐，长度补齐到 SIMD 宽度的整数倍（补齐部分为 0），核函数无需处理尾部
+struct ComplexColumns {
+    const double* re = nullptr;
+    const double* im = nullptr;
+    const double* mag = nullptr; // 预先算好的模，没有时为 nullptr
+    size_t count = 0;
+    
+    Complex operator[](size_t i) const {
+        return Complex(re[i], im[i]);
+    }
+    
+    // 对每个 SIMD 块求比较位，拼成位掩码；返回置位个数。补齐部分的位被清除
+    template<typename Lanes>
+    size_t buildMask(BitMask& mask, Lanes lanes) const {
+        const size_t W = COMPLEX_SIMD_WIDTH;
+        mask.assign((count + 63) / 64, 0);
+        for (size_t i = 0; i < count; i += W) {
+            mask[i / 64] |= (uint64_t)lanes(i) << (i % 64);
+        }
+        size_t total = 0;
+        for (size_t w = 0; w < mask.size(); w++) {
+            if (w == mask.size() - 1 && count % 64) {
+                mask[w] &= ((uint64_t)1 << (count % 64)) - 1;
+            }
+            total += __builtin_popcountll(mask[w]);
+        }
+        return total;
+    }
+    
+    // 批量计算模，out 至少容纳 count 个元素（向上补齐到 SIMD 宽度，须按 COMPLEX_ALIGNMENT 对齐）
+    void magnitudes(double* out) const {
+        for (size_t i = 0; i < count; i += COMPLEX_SIMD_WIDTH) {
+            vstore(out + i, vsqrt(vnorm(vload(re + i), vload(im + i))));
+        }
+    }
+    
+    // 批量计算模的平方
+    void squaredMagnitudes(double* out) const {
+        for (size_t i = 0; i < count; i += COMPLEX_SIMD_WIDTH) {
+            vstore(out + i, vnorm(vload(re + i), vload(im + i)));
+        }
+    }
+    
+    // 与 target 相等（与 Complex::operator== 相同的容差）的元素位掩码，返回相等元素个数
+    size_t equalMask(const Complex& target, BitMask& mask) const {
+        simd_vec tr = vset1(target.getReal());
+        simd_vec ti = vset1(target.getImag());
+        simd_vec eps = vset1(COMPLEX_EPSILON);
+        return buildMask(mask, [&](size_t i) {
+            return vltmask(vabs(vsub(vload(re + i), tr)), eps) & vltmask(vabs(vsub(vload(im + i), ti)), eps);
+        });
+    }
+    
+    // 模在 [m1, m2) 内的元素位掩码，返回命中个数；有模列时直接比较，不再开方
+    size_t rangeMask(double m1, double m2, BitMask& mask) const {
+        simd_vec low = vset1(m1);
+        simd_vec high = vset1(m2);
+        if (mag) {
+            return buildMask(mask, [&](size_t i) {
+                simd_vec m = vload(mag + i);
+                return vgemask(m, low) & vltmask(m, high);
+            });
+        }
+        return buildMask(mask, [&](size_t i) {
+            simd_vec m = vsqrt(vnorm(vload(re + i), vload(im + i)));
+            return vgemask(m, low) & vltmask(m, high);
+        });
+    }
+    
+    // 第一个与 target 相等的元素下标，未找到返回 -1（逐块比较，命中即停）
+    long findFirst(const Complex& target) const {
+        simd_vec tr = vset1(target.getReal());
+        simd_vec ti = vset1(target.getImag());
+        simd_vec eps = vset1(COMPLEX_EPSILON);
+        for (size_t i = 0; i < count; i += COMPLEX_SIMD_WIDTH) {
+            unsigned hit = vltmask(vabs(vsub(vload(re + i), tr)), eps) &
+                           vltmask(vabs(vsub(vload(im + i), ti)), eps);
+            if (hit) {
+                size_t index = i + __builtin_ctz(hit);
+                return index < count ? (long)index : -1;
+            }
+        }
+        return -1;
+    }
+};
+
+// 结构数组（SoA）形式的复数集合：实部、虚部分列连续存放并按缓存行对齐，
+// 批量运算可以整块向量化，扫描只受内存带宽限制。
+// 两列的容量总是补齐到 SIMD 宽度的整数倍，补齐部分为 0，核函数无需处理尾部
+class ComplexArray {
+private:
+    AlignedColumn re;
+    AlignedColumn im;
+    size_t count = 0;
+    
+    static size_t padded(size_t n) {
+        return (n + COMPLEX_SIMD_WIDTH - 1) / COMPLEX_SIMD_WIDTH * COMPLEX_SIMD_WIDTH;
+    }
+    
+public:
+    ComplexArray() {}
+    
+    explicit ComplexArray(const std::vector<Complex>& vec) {
+        assign(vec);
+    }
+    
+    // 从 std::vector<Complex> 导入
+    void assign(const std::vector<Complex>& vec) {
+        count = vec.size();
+        re.assign(padded(count), 0.0);
+        im.assign(padded(count), 0.0);
+        for (size_t i = 0; i < count; i++) {
+            re[i] = vec[i].getReal();
+            im[i] = vec[i].getImag();
+        }
+    }
+    
+    // 导出为 std::vector<Complex>
+    std::vector<Complex> toVector() const {
+        std::vector<Complex> vec;
+        vec.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            vec.push_back(Complex(re[i], im[i]));
+        }
+        return vec;
+    }
+    
+    size_t size() const {
+        return count;
+    }
+    
+    bool empty() const {
+        return count == 0;
+    }
+    
+    Complex operator[](size_t i) const {
+        return Complex(re[i], im[i]);
+    }
+    
+    const double* realData() const {
+        return re.data();
+    }
+    
+    const double* imagData() const {
+        return im.data();
+    }
+    
+    void reserve(size_t n) {
+        re.reserve(padded(n));
+        im.reserve(padded(n));
+    }
+    
+    void push_back(const Complex& c) {
+        if (count == re.size()) {
+            re.resize(padded(count + 1), 0.0);
+            im.resize(padded(count + 1), 0.0);
+        }
+        re[count] = c.getReal();
+        im[count] = c.getImag();
+        count++;
+    }
+    
+    void clear() {
+        re.clear();
+        im.clear();
+        count = 0;
+    }
+    
+    // 按下标列表取出子集（保持下标顺序）
+    ComplexArray gather(const std::vector<size_t>& indices) const {
+        ComplexArray result;
+        result.count = indices.size();
+        result.re.assign(padded(result.count), 0.0);
+        result.im.assign(padded(result.count), 0.0);
+        for (size_t k = 0; k < indices.size(); k++) {
+            result.re[k] = re[indices[k]];
+            result.im[k] = im[indices[k]];
+        }
+        return result;
+    }
+    
+    // 列视图，供各核函数使用
+    ComplexColumns columns() const {
+        ComplexColumns view;
+        view.re = re.data();
+        view.im = im.data();
+        view.count = count;
+        return view;
+    }
+    
+    // 批量计算模，out 至少容纳 size() 个元素（向上补齐到 SIMD 宽度，须按 COMPLEX_ALIGNMENT 对齐）
+    void magnitudes(double* out) const {
+        columns().magnitudes(out);
+    }
+    
+    AlignedColumn magnitudes() const {
+        AlignedColumn out(padded(count));
+        magnitudes(out.data());
+        out.resize(count);
+        return out;
+    }
+    
+    // 批量计算模的平方
+    void squaredMagnitudes(double* out) const {
+        columns().squaredMagnitudes(out);
+    }
+    
+    AlignedColumn squaredMagnitudes() const {
+        AlignedColumn out(padded(count));
+        squaredMagnitudes(out.data());
+        out.resize(count);
+        return out;
+    }
+    
+    // 与 target 相等的元素位掩码，返回相等元素个数
+    size_t equalMask(const Complex& target, BitMask& mask) const {
+        return columns().equalMask(target, mask);
+    }
+    
+    // 模在 [m1, m2) 内的元素位掩码，返回命中个数
+    size_t rangeMask(double m1, double m2, BitMask& mask) const {
+        return columns().rangeMask(m1, m2, mask);
+    }
+    
+    // 第一个与 target 相等的元素下标，未找到返回 -1
+    long findFirst(const Complex& target) const {
+        return columns().findFirst(target);
+    }
+};
+
+// 位掩码中置位元素的下标
+std::vector<size_t> maskIndices(const BitMask& mask) {
+    std::vector<size_t> indices;
+    for (size_t w = 0; w < mask.size(); w++) {
+        for (uint64_t bits = mask[w]; bits; bits &= bits - 1) {
+            indices.push_back(w * 64 + __builtin_ctzll(bits));
+        }
+    }
+    return indices;
+}
+
+// 查找复数（SoA 版本），返回第一个匹配的下标
+int findComplex(const ComplexArray& arr, const Complex& target) {
+    return static_cast<int>(arr.findFirst(target));
+}
+
+// 排序键：预先算好的模与实部，连同元素下标一起排序
+struct MagnitudeKey {
+    double mag;
+    double real;
+    size_t index;
+    
+    bool operator<(const MagnitudeKey& other) const {
+        return magnitudeLess(mag, real, other.mag, other.real);
+    }
+};
+
+// 按 operator< 的顺序求数组元素的排列。键连续存放，排序时不再随机访问原数组；
+// 比较结果与直接排序元素时逐次相同，std::sort 得到的顺序也相同
+std::vector<MagnitudeKey> sortedKeys(const ComplexArray& arr) {
+    AlignedColumn mags = arr.magnitudes();
+    const double* re = arr.realData();
+    std::vector<MagnitudeKey> keys(arr.size());
+    for (size_t k = 0; k < keys.size(); k++) {
+        keys[k] = {mags[k], re[k], k};
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+// 区间查找（列视图版本）：向量化筛选模在 [m1, m2) 的元素，结果按 operator< 排序
+std::vector<Complex> rangeSearch(const ComplexColumns& columns, double m1, double m2) {
+    BitMask mask;
+    columns.rangeMask(m1, m2, mask);
+    ComplexArray hits;
+    std::vector<size_t> indices = maskIndices(mask);
+    hits.reserve(indices.size());
+    for (size_t i : indices) {
+        hits.push_back(columns[i]);
+    }
+    
+    std::vector<Complex> result;
+    result.reserve(hits.size());
+    for (const MagnitudeKey& key : sortedKeys(hits)) {
+        result.push_back(hits[key.index]);
+    }
+    return result;
+}
+
+// 区间查找（SoA 版本）
+std::vector<Complex> rangeSearch(const ComplexArray& arr, double m1, double m2) {
+    return rangeSearch(arr.columns(), m1, m2);
+}
+
+// 向量唯一化（SoA 版本）：模只向量化计算一次，对排序键排序后去除相邻重复，
+// 与 uniqueVector 对同样数据的结果一致
+void uniqueVector(ComplexArray& arr) {
+    std::vector<size_t> kept;
+    for (const MagnitudeKey& key : sortedKeys(arr)) {
+        if (kept.empty() || !(arr[kept.back()] == arr[key.index])) {
+            kept.push_back(key.index);
+        }
+    }
+    arr = arr.gather(kept);
+}
+
+// ===================== 列式文件 =====================
+
+#define COLUMNAR_VERSION 2             //文件格式版本（版本 2 起文件头记录模的最大回落）
+#define COLUMNAR_HAS_MAGNITUDE 1u      //标志位：含预先算好的模列
+#define COLUMNAR_SORTED 2u             //标志位：元素已按 operator< 排序（没有相邻逆序）
+#define COLUMNAR_BUFFER (1 << 16)      //写入时每列缓冲的元素数
+#define COLUMNAR_PAD 8                 //各列长度补齐到 8 个 double（64 字节），满足任意 SIMD 宽度与对齐
+
+// 列式文件头，位于文件开头，共 64 字节；之后依次为实部列、虚部列、可选的模列，
+// 每列从 64 字节对齐的偏移开始，长度补齐到 COLUMNAR_PAD 的整数倍，补齐部分为 0。
+// 数值均为本机字节序
+struct ColumnarHeader {
+    char magic[8];        // "CPLXCOLS"
+    uint32_t version;     // COLUMNAR_VERSION
+    uint32_t flags;       // COLUMNAR_HAS_MAGNITUDE | COLUMNAR_SORTED
+    uint64_t count;       // 元素个数
+    uint64_t realOffset;  // 各列的字节偏移
+    uint64_t imagOffset;
+    uint64_t magOffset;   // 没有模列时为 0
+    double magnitudeDrop; // 模列中元素比其前面最大的模低出的最大值（含 NaN 时为无穷大）
+    uint64_t reserved;
+};
+
+static_assert(sizeof(ColumnarHeader) == COMPLEX_ALIGNMENT, "column file header must be one cache line");
+
+const char COLUMNAR_MAGIC[8] = {'C', 'P', 'L', 'X', 'C', 'O', 'L', 'S'};
+
+// 按元素个数与标志位填写文件头，返回文件总字节数
+uint64_t columnarLayout(ColumnarHeader& header, uint64_t count, uint32_t flags) {
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+    header.version = COLUMNAR_VERSION;
+    header.flags = flags;
+    header.count = count;
+    uint64_t columnBytes = (count + COLUMNAR_PAD - 1) / COLUMNAR_PAD * COLUMNAR_PAD * sizeof(double);
+    header.realOffset = sizeof(ColumnarHeader);
+    header.imagOffset = header.realOffset + columnBytes;
+    uint64_t end = header.imagOffset + columnBytes;
+    if (flags & COLUMNAR_HAS_MAGNITUDE) {
+        header.magOffset = end;
+        end += columnBytes;
+    }
+    return end;
+}
+
+// 文件是否为列式格式（按开头的魔数判断）
+bool isColumnarFile(const std::string& path) {
+    char magic[sizeof(COLUMNAR_MAGIC)] = {};
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    size_t got = std::fread(magic, 1, sizeof(magic), file);
+    std::fclose(file);
+    return got == sizeof(magic) && std::memcmp(magic, COLUMNAR_MAGIC, sizeof(magic)) == 0;
+}
+
+// 流式写入：元素个数须预先给定，每列各有一个缓冲区，写满后写到该列在文件中的位置
+class ColumnarWriter {
+    FILE* file;
+    std::string path;
+    ColumnarHeader header;
+    std::vector<double> buffers[3]; // 实部、虚部、模
+    size_t flushed = 0;             // 已写入文件的元素数
+    size_t pending = 0;             // 缓冲区中的元素数
+    double maxMagnitude = -INFINITY; // 已写入的最大模，用于统计模的回落
+    
+    uint64_t offsetOf(int column) const {
+        return column == 0 ? header.realOffset : column == 1 ? header.imagOffset : header.magOffset;
+    }
+    
+    int columnCount() const {
+        return header.magOffset ? 3 : 2;
+    }
+    
+    void writeAt(uint64_t offset, const void* data, size_t bytes) {
+        if (bytes == 0) {
+            return;
+        }
+#ifdef __unix__
+        bool positioned = fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0; // long 在部分平台上只有 32 位
+#else
+        bool positioned = std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0;
+#endif
+        if (!positioned || std::fwrite(data, 1, bytes, file) != bytes) {
+            throw std::runtime_error("Write failed: " + path);
+        }
+    }
+    
+    void flush() {
+        for (int k = 0; k < columnCount(); k++) {
+            writeAt(offsetOf(k) + flushed * sizeof(double), buffers[k].data(), pending * sizeof(double));
+        }
+        flushed += pending;
+        pending = 0;
+    }
+    
+public:
+    ColumnarWriter(const std::string& path, size_t count, uint32_t flags) : path(path) {
+        columnarLayout(header, count, flags);
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("Cannot create " + path);
+        }
+        for (int k = 0; k < columnCount(); k++) {
+            buffers[k].resize(std::min<size_t>(COLUMNAR_BUFFER, std::max<size_t>(1, count)));
+        }
+        writeAt(0, &header, sizeof(header));
+    }
+    
+    ~ColumnarWriter() {
+        if (file) {
+            std::fclose(file);
+        }
+    }
+    
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+    
+    // 追加一个元素；已知模时直接传入，省去重复计算
+    void append(const Complex& c, double mag) {
+        if (flushed + pending == header.count) {
+            throw std::runtime_error("Too many elements for " + path);
+        }
+        buffers[0][pending] = c.getReal();
+        buffers[1][pending] = c.getImag();
+        if (header.magOffset) {
+            buffers[2][pending] = mag;
+            if (std::isnan(mag)) {
+                header.magnitudeDrop = INFINITY;
+            } else {
+                maxMagnitude = std::max(maxMagnitude, mag);
+                header.magnitudeDrop = std::max(header.magnitudeDrop, maxMagnitude - mag);
+            }
+        }
+        if (++pending == buffers[0].size()) {
+            flush();
+        }
+    }
+    
+    void append(const Complex& c) {
+        append(c, header.magOffset ? c.magnitude() : 0.0);
+    }
+    
+    // 写入剩余元素与各列的补齐部分
+    void close() {
+        flush();
+        if (flushed != header.count) {
+            throw std::runtime_error("Missing elements for " + path);
+        }
+        uint64_t columnBytes = header.imagOffset - header.realOffset;
+        std::vector<char> zeros(columnBytes - header.count * sizeof(double), 0);
+        for (int k = 0; k < columnCount(); k++) {
+            writeAt(offsetOf(k) + header.count * sizeof(double), zeros.data(), zeros.size());
+        }
+        writeAt(0, &header, sizeof(header)); // 补写模的最大回落
+        FILE* closing = file;
+        file = nullptr;
+        if (std::fclose(closing) != 0) {
+            throw std::runtime_error("Write failed: " + path);
+        }
+    }
+};
+
+// 内存映射读取：打开只需校验文件头，数据按需缺页读入，各列直接作为 ComplexColumns 扫描
+class MappedComplexFile {
+    const char* base = nullptr;
+    size_t length = 0;
+    ColumnarHeader header;
+#ifndef __unix__
+    AlignedColumn storage; // 不支持 mmap 时整体读入
+#endif
+    
+    const double* column(uint64_t offset) const {
+        return reinterpret_cast<const double*>(base + offset);
+    }
+    
+public:
+    explicit MappedComplexFile(const std::string& path) {
+#ifdef __unix__
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot open " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length >= sizeof(ColumnarHeader)) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            base = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+        }
+        ::close(fd);
+#else
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        std::fseek(file, 0, SEEK_END);
+        length = static_cast<size_t>(std::ftell(file));
+        std::rewind(file);
+        storage.resize((length + sizeof(double) - 1) / sizeof(double));
+        length = std::fread(storage.data(), 1, length, file);
+        std::fclose(file);
+        base = reinterpret_cast<const char*>(storage.data());
+#endif
+        if (!base || length < sizeof(ColumnarHeader)) {
+            unmap();
+            throw std::runtime_error("Not a complex column file: " + path);
+        }
+        std::memcpy(&header, base, sizeof(header));
+        ColumnarHeader expected;
+        bool valid = std::memcmp(header.magic, COLUMNAR_MAGIC, sizeof(header.magic)) == 0 &&
+                     header.version >= 1 && header.version <= COLUMNAR_VERSION &&
+                     header.count <= length / sizeof(double) &&
+                     columnarLayout(expected, header.count, header.flags) <= length &&
+                     header.realOffset == expected.realOffset && header.imagOffset == expected.imagOffset &&
+                     header.magOffset == expected.magOffset;
+        if (!valid) {
+            unmap();
+            throw std::runtime_error("Not a complex column file (or unsupported version): " + path);
+        }
+    }
+    
+    ~MappedComplexFile() {
+        unmap();
+    }
+    
+    MappedComplexFile(const MappedComplexFile&) = delete;
+    MappedComplexFile& operator=(const MappedComplexFile&) = delete;
+    
+    void unmap() {
+#ifdef __unix__
+        if (base) {
+            munmap(const_cast<char*>(base), length);
+        }
+#endif
+        base = nullptr;
+    }
+    
+    size_t size() const {
+        return header.count;
+    }
+    
+    // 版本 1 的文件没有记录模的回落，不能按有序文件二分查找
+    bool sorted() const {
+        return (header.flags & COLUMNAR_SORTED) && header.version >= 2;
+    }
+    
+    // 模列中元素比其前面最大的模低出的最大值
+    double magnitudeDrop() const {
+        return header.magnitudeDrop;
+    }
+    
+    bool hasMagnitude() const {
+        return header.magOffset != 0;
+    }
+    
+    // 零拷贝列视图
+    ComplexColumns columns() const {
+        ComplexColumns view;
+        view.re = column(header.realOffset);
+        view.im = column(header.imagOffset);
+        view.mag = header.magOffset ? column(header.magOffset) : nullptr;
+        view.count = header.count;
+        return view;
+    }
+    
+    Complex operator[](size_t i) const {
+        return columns()[i];
+    }
+    
+    std::vector<Complex> toVector() const {
+        ComplexColumns view = columns();
+        std::vector<Complex> vec;
+        vec.reserve(view.count);
+        for (size_t i = 0; i < view.count; i++) {
+            vec.push_back(view[i]);
+        }
+        return vec;
+    }
+};
+
+// 写入列式文件
+void writeComplexFile(const std::string& path, const std::vector<Complex>& vec,
+                      uint32_t flags = COLUMNAR_HAS_MAGNITUDE) {
+    ColumnarWriter writer(path, vec.size(), flags);
+    for (const Complex& c : vec) {
+        writer.append(c);
+    }
+    writer.close();
+}
+
+// 读入列式文件或原始格式文件（依次存放每个元素的实部、虚部）
+std::vector<Complex> readComplexFile(const std::string& path) {
+    if (isColumnarFile(path)) {
+        return MappedComplexFile(path).toVector();
+    }
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::vector<Complex> vec;
+    Complex chunk[4096];
+    size_t got;
+    while ((got = std::fread(chunk, sizeof(Complex), 4096, file)) > 0) {
+        vec.insert(vec.end(), chunk, chunk + got);
+    }
+    std::fclose(file);
+    return vec;
+}
+
+// 查找复数（列式文件版本），直接扫描映射的列
+int findComplex(const MappedComplexFile& file, const Complex& target) {
+    return static_cast<int>(file.columns().findFirst(target));
+}
+
+// 在 [begin, end) 中二分出一个位置 p，使 p 前一个元素（若 p != begin）小于 key，
+// p 处的元素（若 p != end）不小于 key。模列并不单调，不满足 std::lower_bound 的前提；
+// 这里只维护上述两端的不变式：lo 左侧紧邻的元素 < key，hi 处的元素 >= key，
+// 对任意序列都成立，区间收缩到 lo == hi 时即得到 p
+inline const double* magnitudeBound(const double* begin, const double* end, double key) {
+    const double* lo = begin;
+    const double* hi = end;
+    while (lo < hi) {
+        const double* mid = lo + (hi - lo) / 2;
+        if (*mid < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// 区间查找（列式文件版本）。有序且带模列的文件先二分查找候选区间：排序只保证没有相邻的
+// operator< 逆序，容差内成链的元素之间模可能连续回落好几个容差，但不会低于之前最大的模减去
+// 文件头记录的最大回落 D，即每个元素的模不低于它之前所有元素的模减去 D。记放宽量
+// W = D + 舍入余量，用 magnitudeBound 求出 first、last：first 前一个元素的模 < m1 - W，
+// 故 first 之前所有元素的模 < m1；last 处元素的模 >= m2 + W，故 last 及之后所有元素的模
+// >= m2。只需逐个筛选 [first, last)。结果保持文件中的顺序，与 rangeSearch(vec, m1, m2)
+// 元素相同，只有顺序可能不同
+std::vector<Complex> rangeSearch(const MappedComplexFile& file, double m1, double m2) {
+    ComplexColumns view = file.columns();
+    double widen = file.magnitudeDrop() * (1 + 1e-15) + COMPLEX_EPSILON;
+    if (!file.sorted() || !view.mag || !(widen < INFINITY)) {
+        return rangeSearch(view, m1, m2);
+    }
+    const double* first = magnitudeBound(view.mag, view.mag + view.count, m1 - widen);
+    const double* last = magnitudeBound(first, view.mag + view.count, m2 + widen);
+    std::vector<Complex> result;
+    for (const double* m = first; m != last; ++m) {
+        if (*m >= m1 && *m < m2) {
+            result.push_back(view[m - view.mag]);
+        }
+    }
+    return result;
+}
+
+// ===================== 外部排序 =====================
+
+#define EXTERNAL_DEFAULT_BUDGET (256u << 20) //默认内存预算（字节）
+#define EXTERNAL_BYTES_PER_ELEMENT 64        //内存中排序每个元素的峰值开销：元素、基数键、暂存区、输出各 16 字节
+#define EXTERNAL_MIN_BUFFER (64u << 10)      //归并时每路缓冲区的最小字节数
+#define EXTERNAL_MAX_FANIN 512               //一趟归并的最大路数
+
+#ifndef COMPLEX_COUNT_OPS
+static_assert(sizeof(Complex) == 2 * sizeof(double) && std::is_trivially_copyable<Complex>::value,
+              "Complex must be stored as two doubles");
+#endif
+
+// 外部排序参数
+struct ExternalSortOptions {
+    size_t memoryBudget = EXTERNAL_DEFAULT_BUDGET; // 内存预算（字节）
+    std::string tempDir;                           // 临时文件目录，为空时取 TMPDIR 或 /tmp
+    bool progress = false;                         // 是否向 std::cerr 输出进度
+};
+
+// 外部排序统计
+struct ExternalSortStats {
+    size_t elements = 0;
+    size_t runs = 0;
+    size_t mergePasses = 0;
+    double runSeconds = 0;   // 生成有序段
+    double mergeSeconds = 0; // 多路归并
+};
+
+// 带大缓冲区的顺序读取
+class ComplexReader {
+    FILE* file;
+    std::vector<Complex> buffer;
+    size_t pos = 0;
+    size_t count = 0;
+    
+public:
+    ComplexReader(FILE* file, size_t bufferBytes)
+        : file(file), buffer(std::max<size_t>(1, bufferBytes / sizeof(Complex))) {}
+    
+    // 读入下一个元素，文件结束时返回 false
+    bool next(Complex& c) {
+        if (pos == count) {
+            count = std::fread(buffer.data(), sizeof(Complex), buffer.size(), file);
+            pos = 0;
+            if (count == 0) {
+                if (std::ferror(file)) {
+                    throw std::runtime_error("Read failed");
+                }
+                return false;
+            }
+        }
+        c = buffer[pos++];
+        return true;
+    }
+};
+
+// 带大缓冲区的顺序写入
+class ComplexWriter {
+    FILE* file;
+    std::vector<Complex> buffer;
+    size_t count = 0;
+    
+public:
+    ComplexWriter(FILE* file, size_t bufferBytes)
+        : file(file), buffer(std::max<size_t>(1, bufferBytes / sizeof(Complex))) {}
+    
+    void put(const Complex& c) {
+        buffer[count++] = c;
+        if (count == buffer.size()) {
+            flush();
+        }
+    }
+    
+    void flush() {
+        if (count > 0 && std::fwrite(buffer.data(), sizeof(Complex), count, file) != count) {
+            throw std::runtime_error("Write failed");
+        }
+        count = 0;
+    }
+};
+
+// 败者树：tree[0] 为胜者，tree[1..k-1] 为各内部结点的败者；相等时编号小的一路胜出，保证稳定
+class LoserTree {
+    std::vector<size_t> tree;
+    std::vector<KeyedComplex> heads;
+    std::vector<bool> exhausted;
+    size_t k;
+    
+    // a 是否胜过 b；编号 k 为初始化用的虚拟叶子，胜过所有叶子
+    bool beats(size_t a, size_t b) const {
+        if (a == k || b == k) {
+            return a == k;
+        }
+        if (exhausted[a] || exhausted[b]) {
+            return !exhausted[a];
+        }
+        if (heads[b] < heads[a]) {
+            return false;
+        }
+        return heads[a] < heads[b] || a < b;
+    }
+    
+    // 叶子 s 的值改变后沿路径向上重赛
+    void replay(size_t s) {
+        for (size_t t = (s + k) / 2; t > 0; t /= 2) {
+            if (beats(tree[t], s)) {
+                std::swap(s, tree[t]);
+            }
+        }
+        tree[0] = s;
+    }
+    
+public:
+    explicit LoserTree(size_t k) : tree(k, k), heads(k), exhausted(k, true), k(k) {}
+    
+    // 设置各路的首元素后调用
+    void set(size_t i, const Complex& c) {
+        heads[i] = KeyedComplex{c.magnitude(), c};
+        exhausted[i] = false;
+    }
+    
+    void build() {
+        for (size_t i = k; i-- > 0;) {
+            replay(i);
+        }
+    }
+    
+    bool empty() const {
+        return exhausted[tree[0]];
+    }
+    
+    size_t winner() const {
+        return tree[0];
+    }
+    
+    // 胜者一路的首元素及其模
+    const KeyedComplex& top() const {
+        return heads[tree[0]];
+    }
+    
+    // 胜者一路前进到下一个元素（或结束）
+    void advance(const Complex* next) {
+        size_t i = tree[0];
+        if (next) {
+            heads[i] = KeyedComplex{next->magnitude(), *next};
+        } else {
+            exhausted[i] = true;
+        }
+        replay(i);
+    }
+};
+
+// 在临时目录中创建临时文件，文件在关闭后自动删除
+FILE* openTempFile(const std::string& dir) {
+#ifdef __unix__
+    std::string path = dir + "/complex_sort_XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create temporary file in " + dir);
+    }
+    unlink(path.c_str());
+    FILE* file = fdopen(fd, "w+b");
+#else
+    (void)dir;
+    FILE* file = std::tmpfile();
+#endif
+    if (!file) {
+        throw std::runtime_error("Cannot create temporary file in " + dir);
+    }
+    return file;
+}
+
+// 外部排序的进度输出：已处理字节数与吞吐率
+class SortProgress {
+    bool enabled;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point phaseStart = start;
+    std::chrono::steady_clock::time_point last = start;
+    
+public:
+    explicit SortProgress(bool enabled) : enabled(enabled) {}
+    
+    // 从开始排序起经过的秒数
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    
+    // 开始新阶段，吞吐率从此刻重新计算
+    void startPhase() {
+        phaseStart = std::chrono::steady_clock::now();
+    }
+    
+    // 每秒最多输出一次，force 时总是输出
+    void report(const std::string& phase, size_t done, size_t total, bool force = false) {
+        auto now = std::chrono::steady_clock::now();
+        if (!enabled || (!force && now - last < std::chrono::seconds(1))) {
+            return;
+        }
+        last = now;
+        double seconds = std::max(1e-9, std::chrono::duration<double>(now - phaseStart).count());
+        double megabytes = done * sizeof(Complex) / 1048576.0;
+        std::cerr << std::fixed << std::setprecision(1) << phase << ": " << megabytes << " MB";
+        if (total > 0) {
+            std::cerr << " (" << 100.0 * done / total << "%)";
+        }
+        std::cerr << ", " << megabytes / seconds << " MB/s" << std::endl;
+    }
+};
+
+// 把若干有序段多路归并，按顺序对每个元素（连同其模）调用 put
+template<typename Put>
+void mergeRuns(std::vector<FILE*>& runs, size_t bufferBytes, SortProgress& progress,
+               const std::string& phase, size_t& done, size_t total, Put put) {
+    if (runs.empty()) {
+        return;
+    }
+    if (done == 0) {
+        progress.startPhase();
+    }
+    std::vector<ComplexReader> readers;
+    LoserTree tree(runs.size());
+    for (size_t i = 0; i < runs.size(); i++) {
+        std::rewind(runs[i]);
+        readers.emplace_back(runs[i], bufferBytes);
+        Complex first;
+        if (readers[i].next(first)) {
+            tree.set(i, first);
+        }
+    }
+    tree.build();
+    
+    Complex next;
+    while (!tree.empty()) {
+        put(tree.top());
+        size_t i = tree.winner();
+        tree.advance(readers[i].next(next) ? &next : nullptr);
+        if (++done % (1 << 20) == 0) {
+            progress.report(phase, done, total);
+        }
+    }
+}
+
+// 外部排序的输入：列式文件（内存映射）或原始格式文件（依次存放实部、虚部）
+class ComplexSource {
+    FILE* raw = nullptr;
+    std::unique_ptr<MappedComplexFile> mapped;
+    size_t total = 0;
+    size_t pos = 0;
+    
+public:
+    explicit ComplexSource(const std::string& path) {
+        if (isColumnarFile(path)) {
+            mapped.reset(new MappedComplexFile(path));
+            total = mapped->size();
+            return;
+        }
+        raw = std::fopen(path.c_str(), "rb");
+        if (!raw) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        std::fseek(raw, 0, SEEK_END);
+        total = static_cast<size_t>(std::ftell(raw)) / sizeof(Complex);
+        std::rewind(raw);
+    }
+    
+    ~ComplexSource() {
+        if (raw) {
+            std::fclose(raw);
+        }
+    }
+    
+    ComplexSource(const ComplexSource&) = delete;
+    ComplexSource& operator=(const ComplexSource&) = delete;
+    
+    size_t size() const {
+        return total;
+    }
+    
+    // 读入至多 max 个元素，返回实际个数
+    size_t read(Complex* out, size_t max) {
+        size_t n = std::min(max, total - pos);
+        if (mapped) {
+            ComplexColumns view = mapped->columns();
+            for (size_t k = 0; k < n; k++) {
+                out[k] = view[pos + k];
+            }
+        } else if (n > 0 && std::fread(out, sizeof(Complex), n, raw) != n) {
+            throw std::runtime_error("Read failed");
+        }
+        pos += n;
+        return n;
+    }
+};
+
+// 外部归并排序：按内存预算分段读入，每段用基数排序排好后写入临时文件，
+// 再用败者树多路归并（路数过多时分多趟）。各段没有相邻的 operator< 逆序，败者树每次输出的胜者
+// 都直接胜过下一个胜者，因此结果中也没有相邻逆序；不存在模在容差内成链的元素时
+// （operator< 为严格弱序），结果与对整个文件做 mergeSort 相同。
+// 输入可以是列式文件或原始格式文件，输出为带模列、标记有序的列式文件
+ExternalSortStats externalSort(const std::string& input, const std::string& output,
+                               const ExternalSortOptions& options = ExternalSortOptions()) {
+    std::string tempDir = options.tempDir;
+    if (tempDir.empty()) {
+        const char* env = std::getenv("TMPDIR");
+        tempDir = env && *env ? env : "/tmp";
+    }
+    size_t budget = std::max<size_t>(options.memoryBudget, 4 * EXTERNAL_MIN_BUFFER);
+    size_t runElements = std::max<size_t>(1, budget / EXTERNAL_BYTES_PER_ELEMENT);
+    size_t fanIn = std::max<size_t>(2, std::min<size_t>(EXTERNAL_MAX_FANIN, budget / EXTERNAL_MIN_BUFFER - 1));
+    
+    ComplexSource in(input);
+    size_t total = in.size();
+    ExternalSortStats stats;
+    SortProgress progress(options.progress);
+    std::vector<FILE*> runs;
+    std::vector<FILE*> merged; // 多趟归并中本趟产生的段
+    auto closeAll = [&] {
+        for (FILE* run : runs) {
+            if (run) {
+                std::fclose(run);
+            }
+        }
+        for (FILE* run : merged) {
+            std::fclose(run);
+        }
+        runs.clear();
+        merged.clear();
+    };
+    
+    try {
+        // 第一阶段：生成有序段
+        std::vector<Complex> chunk;
+        size_t done = 0;
+        while (true) {
+            chunk.resize(runElements);
+            chunk.resize(in.read(chunk.data(), runElements));
+            if (chunk.empty()) {
+                break;
+            }
+            radixSort(chunk);
+            runs.push_back(openTempFile(tempDir));
+            if (std::fwrite(chunk.data(), sizeof(Complex), chunk.size(), runs.back()) != chunk.size()) {
+                throw std::runtime_error("Write failed in " + tempDir);
+            }
+            done += chunk.size();
+            progress.report("生成有序段 " + std::to_string(runs.size()), done, total);
+        }
+        std::vector<Complex>().swap(chunk);
+        stats.elements = done;
+        stats.runs = runs.size();
+        stats.runSeconds = progress.elapsed();
+        progress.report("生成有序段完成（" + std::to_string(runs.size()) + " 段）", done, total, true);
+        
+        // 第二阶段：多路归并，路数超过 fanIn 时先分组归并成更长的段
+        while (runs.size() > fanIn) {
+            stats.mergePasses++;
+            size_t passDone = 0;
+            for (size_t i = 0; i < runs.size(); i += fanIn) {
+                std::vector<FILE*> group(runs.begin() + i, runs.begin() + std::min(runs.size(), i + fanIn));
+                FILE* out = openTempFile(tempDir);
+                merged.push_back(out);
+                ComplexWriter writer(out, budget / (group.size() + 1));
+                mergeRuns(group, budget / (group.size() + 1), progress,
+                          "第 " + std::to_string(stats.mergePasses) + " 趟归并", passDone, stats.elements,
+                          [&](const KeyedComplex& keyed) { writer.put(keyed.value); });
+                writer.flush();
+                for (size_t k = i; k < i + group.size(); k++) {
+                    std::fclose(runs[k]);
+                    runs[k] = nullptr;
+                }
+            }
+            runs.swap(merged);
+            merged.clear();
+        }
+        
+        // 最终归并直接写出列式文件，模在败者树中已经算好
+        ColumnarWriter out(output, stats.elements, COLUMNAR_HAS_MAGNITUDE | COLUMNAR_SORTED);
+        stats.mergePasses += !runs.empty();
+        size_t mergeDone = 0;
+        mergeRuns(runs, budget / (runs.size() + 1), progress, "最终归并", mergeDone, stats.elements,
+                  [&](const KeyedComplex& keyed) { out.append(keyed.value, keyed.mag); });
+        out.close();
+        closeAll();
+        stats.mergeSeconds = progress.elapsed() - stats.runSeconds;
+        if (options.progress) {
+            double seconds = progress.elapsed();
+            std::cerr << "排序完成: " << stats.elements << " 个元素, " << seconds << "s, 平均 "
+                      << stats.elements * sizeof(Complex) / 1048576.0 / std::max(1e-9, seconds) << " MB/s" << std::endl;
+        }
+    } catch (...) {
+        closeAll();
+        throw;
+    }
+    return stats;
+}
+
+#ifdef COMPLEX_COUNT_ALLOCS
+
+// 全局堆分配计数（仅测试构建，编译时加 -DCOMPLEX_COUNT_ALLOCS），
+// 第 (7) 节据此检查自适应排序器建立缓冲后再次排序不分配内存
+std::atomic<size_t> heapAllocations(0);
+
+// 计数版 operator new/delete，不内联
+__attribute__((noinline)) void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+#endif
+
+// 打印向量
+void printVector(const std::vector<Complex>& vec, const std::string& title) {
+    std::cout << title << ": ";
+    for (const Complex& c : vec) {
+        std::cout << c << " ";
+    }
+    std::cout << std::endl;
+}
+
+// 生成模从 6 起按 step（小于容差）递增、辐角随机的复数并置乱：相邻的模都在容差内连成一条链，
+// operator< 在这样的数据上不满足传递性，用来检验排序结果中没有相邻逆序
+std::vector<Complex> generateEpsilonChain(size_t n, double step, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+    std::vector<Complex> vec;
+    for (size_t i = 0; i < n; i++) {
+        double mag = 6 + step * i;
+        double theta = angle(gen);
+        vec.push_back(Complex(mag * cos(theta), mag * sin(theta)));
+    }
+    std::shuffle(vec.begin(), vec.end(), gen);
+    return vec;
+}
+
+// 相邻逆序（后一个元素 operator< 前一个元素）的个数
+size_t countAdjacentInversions(const std::vector<Complex>& vec) {
+    size_t count = 0;
+    for (size_t i = 1; i < vec.size(); i++) {
+        if (vec[i] < vec[i - 1]) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// 计时：执行 body 并返回耗时（秒，按墙钟计）
+template<typename Body>
+double timeSeconds(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 预计算键排序与原排序的对比：complex_operations --sort-bench [N ...]
+void runSortBenchmark(const std::vector<size_t>& sizes) {
+    std::cout << std::fixed << std::setprecision(3);
+    for (size_t n : sizes) {
+        std::vector<Complex> original = generateRandomComplexVector((int)n);
+        std::vector<Complex> expected = original;
+        std::vector<Complex> actual = original;
+        
+        double sortTime = timeSeconds([&] { std::sort(expected.begin(), expected.end()); });
+        double keyedTime = timeSeconds([&] { sortKeyed(actual); });
+        std::cout << "N=" << n << " std::sort " << sortTime << "s, 预计算键 " << keyedTime << "s, 加速比 "
+                  << sortTime / keyedTime << "x, 结果" << (expected == actual ? "一致" : "不一致") << std::endl;
+        
+        expected = original;
+        actual = original;
+        double mergeTime = timeSeconds([&] { mergeSort(expected, 0, (int)expected.size() - 1); });
+        double mergeKeyedTime = timeSeconds([&] { mergeSortKeyed(actual); });
+        std::cout << "N=" << n << " mergeSort " << mergeTime << "s, 预计算键 " << mergeKeyedTime << "s, 加速比 "
+                  << mergeTime / mergeKeyedTime << "x, 结果" << (expected == actual ? "一致" : "不一致") << std::endl;
+        
+        actual = original;
+        double radixTime = timeSeconds([&] { radixSort(actual); });
+        bool radixSame = expected == actual;
+        actual = original;
+        WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        double parallelRadixTime = timeSeconds([&] { radixSort(actual, pool); });
+        std::cout << "N=" << n << " std::sort " << sortTime << "s, 基数排序 " << radixTime << "s（加速比 "
+                  << sortTime / radixTime << "x）, 并行基数排序（" << pool.size() << " 线程）" << parallelRadixTime
+                  << "s（加速比 " << sortTime / parallelRadixTime << "x）, 结果"
+                  << (radixSame && expected == actual ? "一致" : "不一致") << std::endl;
+    }
+}
+
+// 并行归并排序的加速比：complex_operations --parallel-bench [N [线程数 ...]]
+void runParallelBenchmark(size_t n, std::vector<unsigned> threadCounts) {
+    if (threadCounts.empty()) {
+        unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned t = 1; t < hardware; t *= 2) {
+            threadCounts.push_back(t);
+        }
+        threadCounts.push_back(hardware);
+    }
+    
+    std::vector<Complex> original = generateRandomComplexVector((int)n);
+    std::vector<Complex> expected = original;
+    double mergeTime = timeSeconds([&] { mergeSort(expected, 0, (int)expected.size() - 1); });
+    std::cout << std::fixed << std::setprecision(3) << "N=" << n << " mergeSort " << mergeTime << "s" << std::endl;
+    
+    double baseline = 0;
+    for (unsigned t : threadCounts) {
+        WorkStealingPool pool(t);
+        std::vector<Complex> actual = original;
+        double time = timeSeconds([&] { parallelMergeSort(actual, pool); });
+        if (baseline == 0) {
+            baseline = time;
+        }
+        std::cout << "线程数 " << t << ": " << time << "s, 相对 mergeSort 加速比 " << mergeTime / time
+                  << "x, 相对首行 " << baseline / time << "x, 结果" << (actual == expected ? "一致" : "不一致")
+                  << std::endl;
+    }
+}
+
+// 去重引擎在不同重复比例下的对比：complex_operations --unique-bench [N]
+void runUniqueBenchmark(size_t n) {
+    std::mt19937 gen(22);
+    std::uniform_real_distribution<double> dis(-10.0, 10.0);
+    std::vector<Complex> pool(100);
+    for (Complex& c : pool) {
+        c = Complex(dis(gen), dis(gen));
+    }
+    WorkStealingPool workers(std::max(1u, std::thread::hardware_concurrency()));
+    
+    std::cout << std::fixed << std::setprecision(3) << "N=" << n << "，" << workers.size() << " 个线程" << std::endl;
+    for (double ratio : {0.0, 0.2, 0.5, 0.9, 0.99}) {
+        // 比例为 ratio 的元素取自 100 个固定值，其余随机
+        std::vector<Complex> original(n);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        for (Complex& c : original) {
+            c = coin(gen) < ratio ? pool[gen() % pool.size()] : Complex(dis(gen), dis(gen));
+        }
+        
+        std::vector<Complex> expected = original, sorted = original, stable = original, parallel = original;
+        double baseTime = timeSeconds([&] { uniqueVector(expected); });
+        double sortedTime = timeSeconds([&] { uniqueVectorSorted(sorted); });
+        double stableTime = timeSeconds([&] { uniqueVectorStable(stable); });
+        double parallelTime = timeSeconds([&] { uniqueVectorParallel(parallel, workers); });
+        std::vector<Complex> stableSorted = stable;
+        uniqueVector(stableSorted);
+        std::cout << "重复比例 " << ratio << "（剩余 " << expected.size() << "）: uniqueVector " << baseTime
+                  << "s, 有序 " << sortedTime << "s, 保序 " << stableTime << "s, 并行保序 " << parallelTime
+                  << "s, 结果" << (sorted == expected && parallel == stable && stableSorted == expected
+                                   ? "一致" : "不一致") << std::endl;
+    }
+}
+
+// ===================== 基准测试 =====================
+
+#define BENCH_REPS 7                //默认重复次数
+#define BENCH_WARMUP 2              //默认预热次数
+#define BENCH_MIN_LOG 6             //默认最小规模 2^6
+#define BENCH_MAX_LOG 14            //默认最大规模 2^14
+#define BENCH_BATCH_ELEMENTS 65536  //规模较小时一次计时连续运行多份输入，使每次计时至少处理这么多元素
+#define BENCH_QUADRATIC_MAX 8192    //平方级算法的最大规模
+#define BENCH_FEW_UNIQUE 16         //few-unique 分布的不同值个数
+
+// 基准测试的输入分布
+const char* const BENCH_DISTRIBUTIONS[] = {"sorted", "reversed", "random", "few-unique", "dup5", "sawtooth"};
+
+// 按分布生成 n 个元素，同样的参数总是生成同样的数据
+std::vector<Complex> makeBenchInput(const std::string& distribution, size_t n, uint32_t seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dis(-10.0, 10.0);
+    auto random = [&] { return Complex(dis(gen), dis(gen)); };
+    std::vector<Complex> vec(n);
+    
+    if (distribution == "few-unique") {
+        std::vector<Complex> values(BENCH_FEW_UNIQUE);
+        std::generate(values.begin(), values.end(), random);
+        for (Complex& c : vec) {
+            c = values[gen() % values.size()];
+        }
+    } else if (distribution == "dup5") {
+        // 与 generateRandomComplexVector 相同：每 5 个中有一个 (1.5, 2.5)
+        for (size_t i = 0; i < n; i++) {
+            vec[i] = i % 5 == 0 ? Complex(1.5, 2.5) : random();
+        }
+    } else if (distribution == "sawtooth") {
+        // 8 段升序的锯齿
+        size_t period = std::max<size_t>(1, n / 8);
+        std::vector<Complex> tooth(std::min(period, n));
+        std::generate(tooth.begin(), tooth.end(), random);
+        mergeSortKeyed(tooth);
+        for (size_t i = 0; i < n; i++) {
+            vec[i] = tooth[i % period];
+        }
+    } else {
+        std::generate(vec.begin(), vec.end(), random);
+        if (distribution == "sorted" || distribution == "reversed") {
+            mergeSortKeyed(vec);
+        }
+        if (distribution == "reversed") {
+            std::reverse(vec.begin(), vec.end());
+        }
+    }
+    return vec;
+}
+
+// 一个基准：prepare 对输入做不计时的准备（复制数据、建立索引等），返回计时的操作
+struct BenchCase {
+    std::string name;
+    size_t maxN;    // 超过此规模时跳过
+    bool readOnly;  // 操作不修改数据，准备一次即可重复运行
+    std::function<std::function<void()>(const std::vector<Complex>&)> prepare;
+};
+
+// 一组测量结果
+struct BenchResult {
+    std::string name;
+    std::string distribution;
+    size_t n;
+    double medianNs;
+    double p95Ns;
+    double minNs;
+    double comparisons; // 每次运行的比较次数，未计数时为 -1
+    double moves;       // 每次运行的元素复制次数，未计数时为 -1
+};
+
+// 就地修改输入的操作（排序、去重）：每次运行前复制一份输入
+BenchCase benchMutating(const std::string& name, size_t maxN, std::function<void(std::vector<Complex>&)> op) {
+    return {name, maxN, false, [op](const std::vector<Complex>& input) {
+        auto data = std::make_shared<std::vector<Complex>>(input);
+        return std::function<void()>([op, data] { op(*data); });
+    }};
+}
+
+// 只读的操作：在 build 建立的结构上运行 query，build 不计时
+template<typename Build, typename Query>
+BenchCase benchQuery(const std::string& name, Build build, Query query) {
+    return {name, SIZE_MAX, true, [build, query](const std::vector<Complex>& input) {
+        auto structure = std::make_shared<decltype(build(input))>(build(input));
+        return std::function<void()>([query, structure] { query(*structure); });
+    }};
+}
+
+// 防止查询结果被优化掉
+volatile size_t benchSink = 0;
+
+std::vector<BenchCase> benchCases(WorkStealingPool& pool) {
+    const Complex absent(100.0, 100.0); // 不存在的目标，查找需扫描全部元素
+    const double m1 = 2.0, m2 = 5.0;
+    auto copy = [](const std::vector<Complex>& input) { return input; };
+    std::shared_ptr<AdaptiveMergeSorter> sorter = std::make_shared<AdaptiveMergeSorter>();
+    
+    return {
+        benchMutating("bubbleSort", BENCH_QUADRATIC_MAX, [](std::vector<Complex>& v) { bubbleSort(v); }),
+        benchMutating("mergeSort", SIZE_MAX, [](std::vector<Complex>& v) { mergeSort(v, 0, (int)v.size() - 1); }),
+        benchMutating("std::sort", SIZE_MAX, [](std::vector<Complex>& v) { std::sort(v.begin(), v.end()); }),
+        benchMutating("sortKeyed", SIZE_MAX, [](std::vector<Complex>& v) { sortKeyed(v); }),
+        benchMutating("mergeSortKeyed", SIZE_MAX, [](std::vector<Complex>& v) { mergeSortKeyed(v); }),
+        benchMutating("adaptiveMergeSort", SIZE_MAX, [sorter](std::vector<Complex>& v) { sorter->sort(v); }),
+        benchMutating("radixSort", SIZE_MAX, [](std::vector<Complex>& v) { radixSort(v); }),
+        benchMutating("parallelMergeSort", SIZE_MAX, [&pool](std::vector<Complex>& v) { parallelMergeSort(v, pool); }),
+        benchMutating("uniqueVector", SIZE_MAX, [](std::vector<Complex>& v) { uniqueVector(v); }),
+        benchMutating("uniqueVectorSorted", SIZE_MAX, [](std::vector<Complex>& v) { uniqueVectorSorted(v); }),
+        benchMutating("uniqueVectorStable", SIZE_MAX, [](std::vector<Complex>& v) { uniqueVectorStable(v); }),
+        benchMutating("uniqueVectorParallel", SIZE_MAX,
+                      [&pool](std::vector<Complex>& v) { uniqueVectorParallel(v, pool); }),
+        benchQuery("findComplex", copy,
+                   [absent](const std::vector<Complex>& v) { benchSink = benchSink + findComplex(v, absent); }),
+        benchQuery("findComplex(SoA)", [](const std::vector<Complex>& v) { return ComplexArray(v); },
+                   [absent](const ComplexArray& a) { benchSink = benchSink + findComplex(a, absent); }),
+        benchQuery("findComplex(hash)", [](const std::vector<Complex>& v) { return ComplexHashIndex(v); },
+                   [absent](const ComplexHashIndex& index) { benchSink = benchSink + findComplex(index, absent); }),
+        benchQuery("rangeSearch", copy,
+                   [=](const std::vector<Complex>& v) { benchSink = benchSink + rangeSearch(v, m1, m2).size(); }),
+        benchQuery("rangeSearch(SoA)", [](const std::vector<Complex>& v) { return ComplexArray(v); },
+                   [=](const ComplexArray& a) { benchSink = benchSink + rangeSearch(a, m1, m2).size(); }),
+        benchQuery("rangeSearch(index)", [](const std::vector<Complex>& v) { return MagnitudeIndex(v); },
+                   [=](const MagnitudeIndex& index) { benchSink = benchSink + rangeSearch(index, m1, m2).size(); }),
+    };
+}
+
+// 已排序样本的分位数（最近秩法）
+double percentileOf(const std::vector<double>& sorted, double q) {
+    size_t rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// 对一个基准、一种分布、一个规模测量：预热后重复 reps 次，每次连续运行 batch 份输入
+// （只读操作在同一份准备好的数据上连续运行 batch 次）
+BenchResult measure(const BenchCase& bench, const std::string& distribution, size_t n, int warmup, int reps) {
+    std::vector<Complex> input = makeBenchInput(distribution, n, static_cast<uint32_t>(n * 31 + 7));
+    size_t batch = std::max<size_t>(1, BENCH_BATCH_ELEMENTS / std::max<size_t>(1, n));
+    
+    BenchResult result = {bench.name, distribution, n, 0, 0, 0, -1, -1};
+    std::vector<double> samples;
+    for (int rep = -warmup; rep < reps; rep++) {
+        std::vector<std::function<void()>> runs;
+        for (size_t b = 0; b < batch; b++) {
+            runs.push_back(bench.readOnly && b > 0 ? runs[0] : bench.prepare(input));
+        }
+#ifdef COMPLEX_COUNT_OPS
+        uint64_t comparisons = complexComparisons.load();
+        uint64_t moves = complexMoves.load();
+#endif
+        double seconds = timeSeconds([&] {
+            for (auto& run : runs) {
+                run();
+            }
+        });
+#ifdef COMPLEX_COUNT_OPS
+        result.comparisons = double(complexComparisons.load() - comparisons) / batch;
+        result.moves = double(complexMoves.load() - moves) / batch;
+#endif
+        if (rep >= 0) {
+            samples.push_back(seconds * 1e9 / batch);
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    result.medianNs = percentileOf(samples, 0.5);
+    result.p95Ns = percentileOf(samples, 0.95);
+    result.minNs = samples.front();
+    return result;
+}
+
+// 结果写成 JSON
+void writeBenchJson(const std::string& path, const std::vector<BenchResult>& results, int warmup, int reps) {
+    std::ofstream out(path);
+    out << std::setprecision(6) << "{\n  \"simd\": \"" << COMPLEX_SIMD_NAME << "\",\n  \"threads\": "
+        << std::max(1u, std::thread::hardware_concurrency()) << ",\n  \"warmup\": " << warmup << ",\n  \"reps\": "
+        << reps << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\", \"distribution\": \"" << r.distribution
+            << "\", \"n\": " << r.n << ", \"median_ns\": " << r.medianNs << ", \"p95_ns\": " << r.p95Ns
+            << ", \"min_ns\": " << r.minNs << ", \"ns_per_element\": " << r.medianNs / r.n << ", \"comparisons\": ";
+        if (r.comparisons < 0) {
+            out << "null, \"moves\": null}";
+        } else {
+            out << r.comparisons << ", \"moves\": " << r.moves << "}";
+        }
+    }
+    out << "\n  ]\n}\n";
+    if (!out) {
+        throw std::runtime_error("Write failed: " + path);
+    }
+}
+
+// 结果写成 CSV，未计数的列留空
+void writeBenchCsv(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream out(path);
+    out << std::setprecision(6) << "name,distribution,n,median_ns,p95_ns,min_ns,ns_per_element,comparisons,moves\n";
+    for (const BenchResult& r : results) {
+        out << r.name << "," << r.distribution << "," << r.n << "," << r.medianNs << "," << r.p95Ns << ","
+            << r.minNs << "," << r.medianNs / r.n << ",";
+        if (r.comparisons >= 0) {
+            out << r.comparisons << "," << r.moves;
+        } else {
+            out << ",";
+        }
+        out << "\n";
+    }
+    if (!out) {
+        throw std::runtime_error("Write failed: " + path);
+    }
+}
+
+// 基准测试：complex_operations --bench [--min-log K] [--max-log K] [--reps R] [--warmup W]
+//                                       [--only 名称,...] [--dist 分布,...] [--json 路径] [--csv 路径]
+// 规模取 2^min-log 到 2^max-log 的每个 2 的幂；编译时加 -DCOMPLEX_COUNT_OPS 可同时统计比较与复制次数
+int runBenchmarks(int argc, char* argv[]) {
+    int minLog = BENCH_MIN_LOG, maxLog = BENCH_MAX_LOG, reps = BENCH_REPS, warmup = BENCH_WARMUP;
+    std::string jsonPath, csvPath, only, dist;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error: missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--min-log") {
+            minLog = atoi(value.c_str());
+        } else if (arg == "--max-log") {
+            maxLog = atoi(value.c_str());
+        } else if (arg == "--reps") {
+            reps = std::max(1, atoi(value.c_str()));
+        } else if (arg == "--warmup") {
+            warmup = std::max(0, atoi(value.c_str()));
+        } else if (arg == "--only") {
+            only = "," + value + ",";
+        } else if (arg == "--dist") {
+            dist = "," + value + ",";
+        } else if (arg == "--json") {
+            jsonPath = value;
+        } else if (arg == "--csv") {
+            csvPath = value;
+        } else {
+            std::cerr << "Error: unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    
+    WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<BenchResult> results;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::left << std::setw(22) << "name" << std::setw(12) << "distribution" << std::right
+              << std::setw(10) << "n" << std::setw(14) << "median_ns" << std::setw(14) << "p95_ns" << std::setw(10)
+              << "ns/elem" << std::setw(14) << "comparisons" << std::setw(14) << "moves" << std::endl;
+    for (const BenchCase& bench : benchCases(pool)) {
+        if (!only.empty() && only.find("," + bench.name + ",") == std::string::npos) {
+            continue;
+        }
+        for (const char* distribution : BENCH_DISTRIBUTIONS) {
+            if (!dist.empty() && dist.find(std::string(",") + distribution + ",") == std::string::npos) {
+                continue;
+            }
+            for (int log = minLog; log <= maxLog; log++) {
+                size_t n = size_t(1) << log;
+                if (n > bench.maxN) {
+                    break;
+                }
+                BenchResult r = measure(bench, distribution, n, warmup, reps);
+                results.push_back(r);
+                std::cout << std::left << std::setw(22) << r.name << std::setw(12) << r.distribution << std::right
+                          << std::setw(10) << r.n << std::setw(14) << r.medianNs << std::setw(14) << r.p95Ns
+                          << std::setw(10) << std::setprecision(2) << r.medianNs / r.n << std::setprecision(1)
+                          << std::setw(14) << (r.comparisons < 0 ? std::string("-") : std::to_string((uint64_t)r.comparisons))
+                          << std::setw(14) << (r.moves < 0 ? std::string("-") : std::to_string((uint64_t)r.moves))
+                          << std::endl;
+            }
+        }
+    }
+    
+    try {
+        if (!jsonPath.empty()) {
+            writeBenchJson(jsonPath, results, warmup, reps);
+        }
+        if (!csvPath.empty()) {
+            writeBenchCsv(csvPath, results);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmarks(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--parallel-bench") {
+        size_t n = argc > 2 ? strtoull(argv[2], nullptr, 10) : 10000000;
+        std::vector<unsigned> threadCounts;
+        for (int i = 3; i < argc; i++) {
+            threadCounts.push_back((unsigned)atoi(argv[i]));
+        }
+        runParallelBenchmark(n, threadCounts);
+        return 0;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--external-sort") {
+        ExternalSortOptions options;
+        if (argc > 4) {
+            options.memoryBudget = strtoull(argv[4], nullptr, 10) << 20;
+        }
+        options.progress = true;
+        try {
+            ExternalSortStats stats = externalSort(argv[2], argv[3], options);
+            std::cout << stats.elements << " 个元素, " << stats.runs << " 个有序段, " << stats.mergePasses
+                      << " 趟归并, 生成 " << stats.runSeconds << "s, 归并 " << stats.mergeSeconds << "s" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 4 && (std::string(argv[1]) == "--search" || std::string(argv[1]) == "--find")) {
+        try {
+            MappedComplexFile file(argv[2]);
+            double a = atof(argv[3]), b = atof(argv[4]);
+            if (std::string(argv[1]) == "--find") {
+                std::cout << findComplex(file, Complex(a, b)) << std::endl;
+            } else {
+                std::vector<Complex> result;
+                double time = timeSeconds([&] { result = rangeSearch(file, a, b); });
+                std::cout << file.size() << " 个元素中模在[" << a << "," << b << ")之间的有 " << result.size()
+                          << " 个（" << (file.sorted() && file.hasMagnitude() ? "二分查找" : "扫描") << " " << time
+                          << "s）" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--make-complex-file") {
+        writeComplexFile(argv[2], generateRandomComplexVector(atoi(argv[3])));
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--unique-bench") {
+        runUniqueBenchmark(argc > 2 ? strtoull(argv[2], nullptr, 10) : 1000000);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--sort-bench") {
+        std::vector<size_t> sizes;
+        for (int i = 2; i < argc; i++) {
+            sizes.push_back(strtoull(argv[i], nullptr, 10));
+        }
+        if (sizes.empty()) {
+            sizes = {1000000, 10000000};
+        }
+        runSortBenchmark(sizes);
+        return 0;
+    }
+    
+    std::cout << "=== 复数向量操作测试 ===" << std::endl;
+    
+    // (1) 测试无序向量的置乱、查找、插入、删除和唯一化操作
+    std::cout << "\n(1) 测试无序向量的置乱、查找、插入、删除和唯一化操作:" << std::endl;
+    
+    // 生成随机复数向量
+    std::vector<Complex> vec = generateRandomComplexVector(10);
+    printVector(vec, "原始向量");
+    
+    // 测试置乱
+    shuffleVector(vec);
+    printVector(vec, "置乱后向量");
+    
+    // 测试查找
+    Complex target(1.5, 2.5);
+    int index = findComplex(vec, target);
+    std::cout << "查找 " << target << " 的位置: " << index << std::endl;
+    
+    // 测试插入
+    Complex newComplex(3.0, 4.0);
+    insertComplex(vec, 2, newComplex);
+    printVector(vec, "在位置2插入 " + std::string("3.00+4.00i") + " 后");
+    
+    // 测试删除
+    removeComplex(vec, 0);  // 删除位置0的元素
+    printVector(vec, "删除位置0的元素后");
+    
+    // 测试唯一化
+    std::vector<Complex> vecWithDups = generateRandomComplexVector(12);
+    printVector(vecWithDups, "含重复元素的向量");
+    uniqueVector(vecWithDups);
+    printVector(vecWithDups, "唯一化后的向量");
+    
+    // 测试比较容差：实部、虚部或模相差小于 COMPLEX_EPSILON 才视为相同
+    const double tinyStep = COMPLEX_EPSILON / 2;
+    bool toleranceOk = Complex(1.5, 2.5) == Complex(1.5 + tinyStep, 2.5 - tinyStep) &&
+                       !(Complex(1.5, 2.5) == Complex(1.75, 2.5)) &&
+                       !(Complex(1.5, 2.5) == Complex(1.5, 2.5 + 2 * COMPLEX_EPSILON)) &&
+                       Complex(3, 4) < Complex(3.5, 4) && !(Complex(3.5, 4) < Complex(3, 4)) &&
+                       Complex(-3, 4) < Complex(3, -4) && // 模相同时按实部排序
+                       findComplex(std::vector<Complex>{Complex(1.75, 2.5)}, Complex(1.5, 2.5)) == -1;
+    std::cout << "比较容差: " << (toleranceOk ? "一致" : "不一致") << std::endl;
+    
+    // (2) 测试排序和效率比较
+    std::cout << "\n(2) 测试排序和效率比较:" << std::endl;
+    
+    // 准备不同顺序的向量
+    std::vector<Complex> originalVec = generateRandomComplexVector(1000);
+    
+    // 顺序向量
+    std::vector<Complex> orderedVec = originalVec;
+    std::sort(orderedVec.begin(), orderedVec.end());
+    
+    // 逆序向量
+    std::vector<Complex> reverseVec = orderedVec;
+    std::reverse(reverseVec.begin(), reverseVec.end());
+    
+    // 随机向量
+    std::vector<Complex> randomVec = originalVec;
+    
+    // 测试起泡排序
+    std::vector<Complex> testVec;
+    
+    // 测试顺序向量的起泡排序
+    testVec = orderedVec;
+    clock_t start = clock();
+    bubbleSort(testVec);
+    clock_t end = clock();
+    double bubbleOrderedTime = double(end - start) / CLOCKS_PER_SEC;
+    std::cout << "顺序向量起泡排序时间: " << std::fixed << std::setprecision(6) << bubbleOrderedTime << "s" << std::endl;
+    
+    // 测试逆序向量的起泡排序
+    testVec = reverseVec;
+    start = clock();
+    bubbleSort(testVec);
+    end = clock();
+    double bubbleReverseTime = double(end - start) / CLOCKS_PER_SEC;
+    std::cout << "逆序向量起泡排序时间: " << std::fixed << std::setprecision(6) << bubbleReverseTime << "s" << std::endl;
+    
+    // 测试随机向量的起泡排序
+    testVec = randomVec;
+    start = clock();
+    bubbleSort(testVec);
+    end = clock();
+    double bubbleRandomTime = double(end - start) / CLOCKS_PER_SEC;
+    std::cout << "随机向量起泡排序时间: " << std::fixed << std::setprecision(6) << bubbleRandomTime << "s" << std::endl;
+    
+    // 测试归并排序
+    // 测试顺序向量的归并排序
+    testVec = orderedVec;
+    start = clock();
+    mergeSort(testVec, 0, testVec.size() - 1);
+    end = clock();
+    double mergeOrderedTime = double(end - start) / CLOCKS_PER_SEC;
+    std::cout << "顺序向量归并排序时间: " << std::fixed << std::setprecision(6) << mergeOrderedTime << "s" << std::endl;
+    
+    // 测试逆序向量的归并排序
+    testVec = reverseVec;
+    start = clock();
+    mergeSort(testVec, 0, testVec.size() - 1);
+    end = clock();
+    double mergeReverseTime = double(end - start) / CLOCKS_PER_SEC;
+    std::cout << "逆序向量归并排序时间: " << std::fixed << std::setprecision(6) << mergeReverseTime << "s" << std::endl;
+    
+    // 测试随机向量的归并排序
+    testVec = randomVec;
+    start = clock();
+    mergeSort(testVec, 0, testVec.size() - 1);
+    end = clock();
+    double mergeRandomTime = double(end - start) / CLOCKS_PER_SEC;
+    std::cout << "随机向量归并排序时间: " << std::fixed << std::setprecision(6) << mergeRandomTime << "s" << std::endl;
+    
+    // (3) 测试区间查找算法
+    std::cout << "\n(3) 测试区间查找算法:" << std::endl;
+    
+    std::vector<Complex> searchVec = generateRandomComplexVector(20);
+    printVector(searchVec, "用于区间查找的向量");
+    
+    // 对向量进行排序，以便测试区间查找
+    std::sort(searchVec.begin(), searchVec.end());
+    printVector(searchVec, "排序后的向量");
+    
+    double m1 = 2.0, m2 = 5.0;
+    std::vector<Complex> rangeResult = rangeSearch(searchVec, m1, m2);
+    printVector(rangeResult, "模在[" + std::to_string(m1) + "," + std::to_string(m2) + ")之间的元素");
+    
+    // (4) 测试结构数组（SoA）形式的批量运算
+    std::cout << "\n(4) 测试结构数组（SoA）批量运算（" << COMPLEX_SIMD_NAME << "）:" << std::endl;
+    std::cout << std::setprecision(6);
+    
+    std::vector<Complex> bigVec = generateRandomComplexVector(1 << 22);
+    ComplexArray bigArr(bigVec);
+    Complex absent(100.0, 100.0);
+    
+    start = clock();
+    int vecIndex = findComplex(bigVec, absent);
+    double vecFindTime = double(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    int arrIndex = findComplex(bigArr, absent);
+    double arrFindTime = double(clock() - start) / CLOCKS_PER_SEC;
+    std::cout << "查找（" << bigVec.size() << " 个元素，目标不存在）: vector " << vecFindTime << "s, SoA "
+              << arrFindTime << "s, 结果" << (vecIndex == arrIndex ? "一致" : "不一致") << std::endl;
+    
+    start = clock();
+    std::vector<Complex> vecRange = rangeSearch(bigVec, m1, m2);
+    double vecRangeTime = double(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    std::vector<Complex> arrRange = rangeSearch(bigArr, m1, m2);
+    double arrRangeTime = double(clock() - start) / CLOCKS_PER_SEC;
+    std::cout << "区间查找（命中 " << vecRange.size() << " 个）: vector " << vecRangeTime << "s, SoA "
+              << arrRangeTime << "s, 结果" << (vecRange == arrRange ? "一致" : "不一致") << std::endl;
+    
+    start = clock();
+    uniqueVector(bigVec);
+    double vecUniqueTime = double(clock() - start) / CLOCKS_PER_SEC;
+    start = clock();
+    uniqueVector(bigArr);
+    double arrUniqueTime = double(clock() - start) / CLOCKS_PER_SEC;
+    std::cout << "唯一化（剩余 " << bigVec.size() << " 个）: vector " << vecUniqueTime << "s, SoA "
+              << arrUniqueTime << "s, 结果" << (bigVec == bigArr.toVector() ? "一致" : "不一致") << std::endl;
+    
+    // (5) 测试预计算排序键的排序
+    std::cout << "\n(5) 测试预计算排序键的排序:" << std::endl;
+    testVec = randomVec;
+    bubbleSort(testVec);
+    std::vector<Complex> keyedVec = randomVec;
+    double bubbleKeyedTime = timeSeconds([&] { bubbleSortKeyed(keyedVec); });
+    std::cout << "随机向量起泡排序（预计算键）时间: " << bubbleKeyedTime << "s, 结果"
+              << (keyedVec == testVec ? "一致" : "不一致") << std::endl;
+    runSortBenchmark({1000000});
+    {
+        // 模以 0.6e-9 的间隔成链的数据：基数排序修正后不应留有相邻逆序
+        WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        size_t inversions[3] = {0, 0, 0};
+        for (unsigned seed = 1; seed <= 10; seed++) {
+            std::vector<Complex> chain = generateEpsilonChain(5000, 0.6e-9, seed);
+            std::vector<Complex> sorted = chain;
+            radixSort(sorted);
+            inversions[0] += countAdjacentInversions(sorted);
+            sorted = chain;
+            radixSort(sorted, pool);
+            inversions[1] += countAdjacentInversions(sorted);
+            sorted = chain;
+            mergeSort(sorted, 0, (int)sorted.size() - 1);
+            inversions[2] += countAdjacentInversions(sorted);
+        }
+        std::cout << "容差链数据（10 组 5000 个元素）相邻逆序: 基数排序 " << inversions[0] << ", 并行基数排序 "
+                  << inversions[1] << ", mergeSort " << inversions[2] << ", 结果"
+                  << (inversions[0] + inversions[1] + inversions[2] == 0 ? "一致" : "不一致") << std::endl;
+    }
+    
+    // (6) 测试并行归并排序：含大量模与实部都相同、虚部不同的元素，检验稳定性
+    std::cout << "\n(6) 测试并行归并排序:" << std::endl;
+    std::vector<Complex> stableVec = generateRandomComplexVector(300000);
+    for (size_t i = 0; i < stableVec.size(); i += 3) {
+        stableVec[i] = Complex(3.0, i % 2 ? 4.0 : -4.0);
+    }
+    std::vector<Complex> stableExpected = stableVec;
+    std::stable_sort(stableExpected.begin(), stableExpected.end());
+    std::vector<Complex> stableMerge = stableVec;
+    mergeSort(stableMerge, 0, (int)stableMerge.size() - 1);
+    {
+        WorkStealingPool pool(4);
+        std::vector<Complex> stableParallel = stableVec;
+        parallelMergeSort(stableParallel, pool, 1000);
+        std::cout << "mergeSort 与 std::stable_sort " << (stableMerge == stableExpected ? "一致" : "不一致")
+                  << ", 并行归并排序（4 线程）与 mergeSort " << (stableParallel == stableMerge ? "一致" : "不一致")
+                  << std::endl;
+    }
+    
+    // (7) 测试自适应归并排序：利用已有的有序段
+    std::cout << "\n(7) 测试自适应归并排序:" << std::endl;
+    {
+        AdaptiveMergeSorter sorter;
+        std::vector<Complex> bigRandom = generateRandomComplexVector(1000000);
+        std::vector<Complex> bigOrdered = bigRandom;
+        sortKeyed(bigOrdered);
+        std::vector<Complex> bigReverse(bigOrdered.rbegin(), bigOrdered.rend());
+        // 部分有序：有序数据中每 1000 个元素打乱一段
+        std::vector<Complex> bigPartial = bigOrdered;
+        std::mt19937 gen(7);
+        for (size_t i = 0; i + 1000 <= bigPartial.size(); i += 100000) {
+            std::shuffle(bigPartial.begin() + i, bigPartial.begin() + i + 1000, gen);
+        }
+        
+        std::pair<std::string, std::vector<Complex>*> inputs[] = {
+            {"顺序", &bigOrdered}, {"逆序", &bigReverse}, {"部分有序", &bigPartial}, {"随机", &bigRandom}};
+        for (auto& input : inputs) {
+            std::vector<Complex> expected = *input.second;
+            double mergeTime = timeSeconds([&] { mergeSort(expected, 0, (int)expected.size() - 1); });
+            std::vector<Complex> actual = *input.second;
+            sorter.sort(actual); // 首次排序建立缓冲
+            actual = *input.second;
+#ifdef COMPLEX_COUNT_ALLOCS
+            size_t before = heapAllocations;
+#endif
+            double adaptiveTime = timeSeconds([&] { sorter.sort(actual); });
+#ifdef COMPLEX_COUNT_ALLOCS
+            std::string allocations = ", 堆分配 " + std::to_string(heapAllocations - before) + " 次";
+#else
+            std::string allocations;
+#endif
+            std::cout << input.first << "（" << actual.size() << " 个元素）: mergeSort " << mergeTime
+                      << "s, 自适应 " << adaptiveTime << "s" << allocations << ", 结果"
+                      << (actual == expected ? "一致" : "不一致") << std::endl;
+        }
+#ifndef COMPLEX_COUNT_ALLOCS
+        std::cout << "（未启用堆分配计数，编译时加 -DCOMPLEX_COUNT_ALLOCS）" << std::endl;
+#endif
+        
+        // 与原测试相同的 1000 个元素
+        std::vector<Complex> small = orderedVec;
+        sorter.sort(small);
+        std::vector<Complex> smallReverse = reverseVec;
+        sorter.sort(smallReverse);
+        std::vector<Complex> smallRandom = randomVec;
+        sorter.sort(smallRandom);
+        std::vector<Complex> smallExpected = randomVec;
+        mergeSort(smallExpected, 0, (int)smallExpected.size() - 1);
+        std::cout << "1000 个元素的顺序、逆序、随机向量: 结果"
+                  << (small == smallExpected && smallReverse == smallExpected && smallRandom == smallExpected
+                      ? "一致" : "不一致") << std::endl;
+    }
+    
+    // (8) 测试模索引：区间查找不再扫描整个向量
+    std::cout << "\n(8) 测试模索引:" << std::endl;
+    {
+        std::vector<Complex> indexed = generateRandomComplexVector(1000000);
+        MagnitudeIndex index;
+        double buildTime = timeSeconds([&] { index = MagnitudeIndex(indexed); });
+        
+        std::mt19937 gen(8);
+        std::uniform_real_distribution<double> dis(0.0, 14.0);
+        std::vector<std::pair<double, double>> queries(1000);
+        for (auto& query : queries) {
+            double a = dis(gen);
+            query = {a, a + 0.05};
+        }
+        queries[0] = {m1, m2};
+        queries[1] = {Complex(1.5, 2.5).magnitude(), Complex(1.5, 2.5).magnitude() + 1e-12}; // 落在重复元素上
+        
+        size_t scanHits = 0, indexHits = 0, batchHits = 0;
+        bool same = true;
+        double scanTime = timeSeconds([&] {
+            for (size_t q = 0; q < 20; q++) {
+                scanHits += rangeSearch(indexed, queries[q].first, queries[q].second).size();
+            }
+        });
+        for (size_t q = 0; q < 20; q++) {
+            same = same && rangeSearch(index, queries[q].first, queries[q].second) ==
+                           rangeSearch(indexed, queries[q].first, queries[q].second);
+        }
+        double indexTime = timeSeconds([&] {
+            for (const auto& query : queries) {
+                indexHits += index.range(query.first, query.second).size();
+            }
+        });
+        std::vector<MagnitudeIndex::Range> batch;
+        double batchTime = timeSeconds([&] { batch = index.ranges(queries); });
+        for (size_t q = 0; q < queries.size(); q++) {
+            MagnitudeIndex::Range single = index.range(queries[q].first, queries[q].second);
+            same = same && batch[q].begin() == single.begin() && batch[q].end() == single.end();
+            batchHits += batch[q].size();
+        }
+        std::cout << "建立索引（" << indexed.size() << " 个元素）: " << buildTime << "s" << std::endl;
+        std::cout << "20 次扫描查找: " << scanTime << "s（命中 " << scanHits << "）, 1000 次索引查找: "
+                  << indexTime << "s, 1000 次批量查找: " << batchTime << "s, 命中 " << indexHits << "/"
+                  << batchHits << ", 结果" << (same ? "一致" : "不一致") << std::endl;
+        
+        // 增量插入、删除后索引与向量保持一致
+        std::vector<Complex> small = generateRandomComplexVector(2000);
+        MagnitudeIndex smallIndex(small);
+        std::uniform_int_distribution<int> coin(0, 1);
+        for (int step = 0; step < 2000; step++) {
+            int size = static_cast<int>(small.size());
+            if (coin(gen) || size == 0) {
+                int position = std::uniform_int_distribution<int>(0, size)(gen);
+                insertComplex(small, smallIndex, position, Complex(dis(gen) - 7.0, dis(gen) - 7.0));
+            } else {
+                removeComplex(small, smallIndex, std::uniform_int_distribution<int>(0, size - 1)(gen));
+            }
+        }
+        bool synced = smallIndex.size() == small.size();
+        MagnitudeIndex::Range all = smallIndex.range(0.0, 100.0);
+        for (size_t rank = 0; synced && rank < all.size(); rank++) {
+            synced = all.begin()[rank] == small[smallIndex.position(rank)];
+        }
+        for (size_t q = 0; synced && q < queries.size(); q++) {
+            synced = rangeSearch(smallIndex, queries[q].first, queries[q].second) ==
+                     rangeSearch(small, queries[q].first, queries[q].second);
+        }
+        std::cout << "2000 次随机插入/删除后: 索引" << (synced ? "一致" : "不一致") << std::endl;
+    }
+    
+    // (9) 测试哈希索引：查找与按值删除不再线性扫描
+    std::cout << "\n(9) 测试哈希索引:" << std::endl;
+    {
+        std::vector<Complex> hashed = generateRandomComplexVector(20000);
+        std::mt19937 gen(9);
+        std::uniform_int_distribution<size_t> pick(0, hashed.size() - 1);
+        std::vector<Complex> targets;
+        for (int i = 0; i < 2000; i++) {
+            Complex c = hashed[pick(gen)];
+            targets.push_back(c);
+            targets.push_back(Complex(c.getReal() + 0.6 * COMPLEX_EPSILON, c.getImag() - 0.6 * COMPLEX_EPSILON)); // 容差内
+            targets.push_back(Complex(c.getReal() + 1.5 * COMPLEX_EPSILON, c.getImag())); // 容差外
+        }
+        
+        ComplexHashIndex index;
+        double buildTime = timeSeconds([&] { index = ComplexHashIndex(hashed); });
+        std::vector<int> linear(targets.size()), viaHash(targets.size());
+        double linearTime = timeSeconds([&] {
+            for (size_t i = 0; i < targets.size(); i++) {
+                linear[i] = findComplex(hashed, targets[i]);
+            }
+        });
+        double hashTime = timeSeconds([&] {
+            for (size_t i = 0; i < targets.size(); i++) {
+                viaHash[i] = findComplex(index, targets[i]);
+            }
+        });
+        std::cout << targets.size() << " 次查找（" << hashed.size() << " 个元素）: 线性 " << linearTime
+                  << "s, 哈希 " << hashTime << "s（建立 " << buildTime << "s）, 结果"
+                  << (linear == viaHash ? "一致" : "不一致") << std::endl;
+        
+        // 随机插入、删除、按值删除后索引与向量保持一致
+        std::vector<Complex> plain = hashed;
+        std::uniform_int_distribution<int> action(0, 2);
+        bool synced = true;
+        double removeTime = timeSeconds([&] {
+            for (int step = 0; step < 3000; step++) {
+                int size = static_cast<int>(hashed.size());
+                switch (action(gen)) {
+                case 0: {
+                    int position = std::uniform_int_distribution<int>(0, size)(gen);
+                    Complex c = targets[pick(gen) % targets.size()];
+                    insertComplex(hashed, index, position, c);
+                    insertComplex(plain, position, c);
+                    break;
+                }
+                case 1: {
+                    int position = std::uniform_int_distribution<int>(0, size - 1)(gen);
+                    removeComplex(hashed, index, position);
+                    removeComplex(plain, position);
+                    break;
+                }
+                default: {
+                    Complex c = targets[pick(gen) % targets.size()];
+                    synced = synced && removeComplexByValue(hashed, index, c) == removeComplexByValue(plain, c);
+                    break;
+                }
+                }
+            }
+        });
+        synced = synced && hashed == plain && index.size() == plain.size();
+        for (size_t i = 0; synced && i < targets.size(); i++) {
+            synced = findComplex(index, targets[i]) == findComplex(plain, targets[i]);
+        }
+        std::cout << "3000 次随机插入/删除/按值删除（" << removeTime << "s）后: 索引"
+                  << (synced ? "一致" : "不一致") << std::endl;
+    }
+    
+    // (10) 测试分块序列：按位置插入、删除
+    std::cout << "\n(10) 测试分块序列:" << std::endl;
+    {
+        std::vector<Complex> vec = generateRandomComplexVector(500000);
+        ChunkedComplexList list(vec);
+        std::mt19937 gen(10);
+        std::vector<std::pair<int, Complex>> edits; // 位置为负表示删除
+        size_t size = vec.size();
+        for (int i = 0; i < 20000; i++) {
+            if (i % 2 == 0) {
+                edits.push_back({std::uniform_int_distribution<int>(0, (int)size)(gen), Complex(i % 7, i % 11)});
+                size++;
+            } else {
+                edits.push_back({-1 - std::uniform_int_distribution<int>(0, (int)size - 1)(gen), Complex()});
+                size--;
+            }
+        }
+        auto apply = [&](auto& target) {
+            for (const auto& edit : edits) {
+                if (edit.first >= 0) {
+                    insertComplex(target, edit.first, edit.second);
+                } else {
+                    removeComplex(target, -1 - edit.first);
+                }
+            }
+        };
+        double vecTime = timeSeconds([&] { apply(vec); });
+        double listTime = timeSeconds([&] { apply(list); });
+        bool same = list.toVector() == vec;
+        std::cout << edits.size() << " 次按位置插入/删除（" << vec.size() << " 个元素）: vector " << vecTime
+                  << "s, 分块 " << listTime << "s（" << list.chunkCount() << " 块）, 结果"
+                  << (same ? "一致" : "不一致") << std::endl;
+        
+        // 其余操作与向量版本一致
+        Complex probe = vec[vec.size() / 2];
+        same = findComplex(list, probe) == findComplex(vec, probe) && list[vec.size() / 3] == vec[vec.size() / 3];
+        same = same && rangeSearch(list, m1, m2) == rangeSearch(vec, m1, m2);
+        same = same && removeComplexByValue(list, probe) == removeComplexByValue(vec, probe) && list.toVector() == vec;
+        ChunkedComplexList sorted = list;
+        mergeSort(sorted);
+        mergeSort(vec, 0, (int)vec.size() - 1);
+        same = same && sorted.toVector() == vec;
+        uniqueVector(list);
+        uniqueVector(vec);
+        same = same && list.toVector() == vec;
+        std::cout << "查找、区间查找、按值删除、排序、唯一化: 结果" << (same ? "一致" : "不一致") << std::endl;
+    }
+    
+    // (11) 测试哈希去重
+    std::cout << "\n(11) 测试哈希去重:" << std::endl;
+    {
+        WorkStealingPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<Complex> original = generateRandomComplexVector(1000000);
+        std::vector<Complex> expected = original, sorted = original, stable = original, parallel = original;
+        double baseTime = timeSeconds([&] { uniqueVector(expected); });
+        double sortedTime = timeSeconds([&] { uniqueVectorSorted(sorted); });
+        double stableTime = timeSeconds([&] { uniqueVectorStable(stable); });
+        double parallelTime = timeSeconds([&] { uniqueVectorParallel(parallel, pool); });
+        std::cout << "1000000 个元素（每 5 个中有一个重复）: uniqueVector " << baseTime << "s, 有序 " << sortedTime
+                  << "s, 保序 " << stableTime << "s, 并行保序 " << parallelTime << "s" << std::endl;
+        std::cout << "有序结果与 uniqueVector " << (sorted == expected ? "一致" : "不一致") << ", 并行与保序结果"
+                  << (parallel == stable ? "一致" : "不一致") << ", 保序结果保留首次出现顺序: "
+                  << (stable.size() == expected.size() && stable[0] == original[0] ? "是" : "否") << std::endl;
+    }
+    
+    // (12) 测试外部归并排序
+    std::cout << "\n(12) 测试外部归并排序:" << std::endl;
+    {
+        const char* env = std::getenv("TMPDIR");
+        std::string dir = env && *env ? env : "/tmp";
+        std::string input = dir + "/complex_sort_input.bin";
+        std::string output = dir + "/complex_sort_output.bin";
+        std::pair<size_t, size_t> cases[] = {{2000000, 4u << 20}, {200000, 256u << 10}}; // (元素数, 内存预算)
+        for (const auto& test : cases) {
+            std::vector<Complex> data = generateRandomComplexVector((int)test.first);
+            writeComplexFile(input, data);
+            ExternalSortOptions options;
+            options.memoryBudget = test.second;
+            ExternalSortStats stats = externalSort(input, output, options);
+            mergeSort(data, 0, (int)data.size() - 1);
+            std::cout << stats.elements << " 个元素, 内存预算 " << (test.second >> 10) << " KB: " << stats.runs
+                      << " 个有序段, " << stats.mergePasses << " 趟归并, 生成 " << stats.runSeconds << "s, 归并 "
+                      << stats.mergeSeconds << "s, 结果" << (readComplexFile(output) == data ? "一致" : "不一致")
+                      << std::endl;
+        }
+        
+        // 模以不足容差的间隔成链的数据，分多段、多趟归并后不应留有相邻逆序
+        size_t inversions = 0;
+        for (unsigned seed = 1; seed <= 5; seed++) {
+            writeComplexFile(input, generateEpsilonChain(20000, 0.6e-9, seed));
+            ExternalSortOptions options;
+            options.memoryBudget = 256u << 10;
+            externalSort(input, output, options);
+            inversions += countAdjacentInversions(readComplexFile(output));
+        }
+        std::cout << "容差链数据（5 组 20000 个元素）相邻逆序 " << inversions << " 个, 结果"
+                  << (inversions == 0 ? "一致" : "不一致") << std::endl;
+        std::remove(input.c_str());
+        std::remove(output.c_str());
+    }
+    
+    // (13) 测试列式文件与内存映射读取
+    std::cout << "\n(13) 测试列式文件:" << std::endl;
+    {
+        const char* env = std::getenv("TMPDIR");
+        std::string dir = env && *env ? env : "/tmp";
+        std::string path = dir + "/complex_columns.bin";
+        std::string sortedPath = dir + "/complex_columns_sorted.bin";
+        std::vector<Complex> data = generateRandomComplexVector(2000000);
+        double writeTime = timeSeconds([&] { writeComplexFile(path, data); });
+        
+        std::unique_ptr<MappedComplexFile> file;
+        double openTime = timeSeconds([&] { file.reset(new MappedComplexFile(path)); });
+        Complex target = data[data.size() - 3];
+        int fileIndex = -1;
+        double findTime = timeSeconds([&] { fileIndex = findComplex(*file, target); });
+        std::vector<Complex> fileRange;
+        double rangeTime = timeSeconds([&] { fileRange = rangeSearch(*file, m1, m2); });
+        bool same = file->size() == data.size() && fileIndex == findComplex(data, target) &&
+                    fileRange == rangeSearch(data, m1, m2) && (*file)[12345] == data[12345];
+        std::cout << data.size() << " 个元素: 写入 " << writeTime << "s, 打开 " << openTime << "s, 查找 " << findTime
+                  << "s, 区间查找 " << rangeTime << "s, 结果" << (same ? "一致" : "不一致") << std::endl;
+        
+        // 外部排序的输出为有序列式文件，区间查找改用二分
+        externalSort(path, sortedPath);
+        MappedComplexFile sortedFile(sortedPath);
+        std::vector<Complex> sortedRange;
+        double sortedRangeTime = timeSeconds([&] { sortedRange = rangeSearch(sortedFile, m1, m2); });
+        std::vector<Complex> expected = data;
+        mergeSort(expected, 0, (int)expected.size() - 1);
+        same = sortedFile.sorted() && sortedFile.hasMagnitude() && sortedRange == rangeSearch(data, m1, m2) &&
+               sortedFile.toVector() == expected;
+        std::cout << "外部排序后的有序文件: 区间查找 " << sortedRangeTime << "s, 结果" << (same ? "一致" : "不一致")
+                  << std::endl;
+        
+        // 模以不足容差的间隔成链时，有序文件中的模会回落几个容差，二分查找仍应找到全部元素
+        auto byBits = [](const Complex& a, const Complex& b) {
+            return a.getReal() != b.getReal() ? a.getReal() < b.getReal() : a.getImag() < b.getImag();
+        };
+        size_t mismatches = 0;
+        double maxDrop = 0;
+        std::mt19937 gen(11);
+        for (unsigned seed = 1; seed <= 5; seed++) {
+            std::vector<Complex> chain = generateEpsilonChain(20000, 0.3e-9, seed);
+            writeComplexFile(path, chain);
+            externalSort(path, sortedPath);
+            MappedComplexFile chainFile(sortedPath);
+            maxDrop = std::max(maxDrop, chainFile.magnitudeDrop());
+            std::uniform_real_distribution<double> lower(6, 6 + 20000 * 0.3e-9);
+            for (int q = 0; q < 100; q++) {
+                double lo = lower(gen);
+                double hi = lo + 4e-9;
+                std::vector<Complex> found = rangeSearch(chainFile, lo, hi);
+                std::vector<Complex> wanted = rangeSearch(chain, lo, hi);
+                std::sort(found.begin(), found.end(), byBits);
+                std::sort(wanted.begin(), wanted.end(), byBits);
+                mismatches += found != wanted;
+            }
+        }
+        std::cout << "容差链数据的有序文件: 模最大回落 " << std::setprecision(1) << maxDrop / COMPLEX_EPSILON
+                  << std::setprecision(3) << " 个容差, 500 次区间查找, 结果" << (mismatches == 0 ? "一致" : "不一致")
+                  << std::endl;
+        file.reset();
+        std::remove(path.c_str());
+        std::remove(sortedPath.c_str());
+    }
     
     std::cout << "\n效率比较总结:" << std::endl;
     std::cout << "起泡排序 - 顺序:" << std::fixed << std::setprecision(6) << bubbleOrderedTime 